@@ -14,6 +14,179 @@
 #include <limits.h>
 #include "mg_port.h"
 
+/*
+ * Tracing hooks, the port may define any of them. Hooks may be called with 
+ * interrupts disabled, so they must be short and must not call the kernel.
+ */
+#ifndef MG_TRACE_ACTOR_ACTIVATE
+#define MG_TRACE_ACTOR_ACTIVATE(actor, cpu, vect)
+#endif
+
+#ifndef MG_TRACE_ACTOR_START
+#define MG_TRACE_ACTOR_START(actor, msg)
+#endif
+
+#ifndef MG_TRACE_ACTOR_STOP
+#define MG_TRACE_ACTOR_STOP(actor, q)
+#endif
+
+#ifndef MG_TRACE_QUEUE_PUSH
+#define MG_TRACE_QUEUE_PUSH(q, msg)
+#endif
+
+#ifndef MG_TRACE_QUEUE_POP
+#define MG_TRACE_QUEUE_POP(q, msg)
+#endif
+
+#ifndef MG_TRACE_QUEUE_SUBSCRIBE
+#define MG_TRACE_QUEUE_SUBSCRIBE(q, actor)
+#endif
+
+#ifndef MG_TRACE_POOL_ALLOC
+#define MG_TRACE_POOL_ALLOC(pool, msg)
+#endif
+
+#ifndef MG_TRACE_POOL_FREE
+#define MG_TRACE_POOL_FREE(pool, msg)
+#endif
+
+#ifndef MG_TRACE_POOL_EMPTY
+#define MG_TRACE_POOL_EMPTY(pool)
+#endif
+
+#ifndef MG_TRACE_TIMER_ARM
+#define MG_TRACE_TIMER_ARM(actor, ticks)
+#endif
+
+#ifndef MG_TRACE_TIMER_EXPIRE
+#define MG_TRACE_TIMER_EXPIRE(actor)
+#endif
+
+#ifndef MG_TRACE_LOCK_ACQUIRE
+#define MG_TRACE_LOCK_ACQUIRE(lock)
+#endif
+
+#ifndef MG_TRACE_LOCK_RELEASE
+#define MG_TRACE_LOCK_RELEASE(lock)
+#endif
+
+#ifdef MG_IRQ_STATS
+#ifndef MG_IRQ_BUCKETS
+#define MG_IRQ_BUCKETS 16
+#endif
+
+#ifdef MG_CPU_MAX
+#   include <stdatomic.h>
+#   define _MG_IRQ_CPUS MG_CPU_MAX
+#   define _mg_irq_cpu() mg_cpu_this()
+#else
+#   define _MG_IRQ_CPUS 1
+#   define _mg_irq_cpu() 0
+#endif
+
+/*
+ * Each place in the kernel which disables interrupts has its own static
+ * record, which is linked into the global list on first use. Bucket i of the
+ * histogram counts sections which lasted 2^i to 2^(i+1)-1 cycles, the last
+ * one also counts all longer sections.
+ */
+struct mg_irq_site_t {
+    const char* func;
+    unsigned line;
+    struct mg_irq_site_t* next;
+#ifdef MG_CPU_MAX
+    atomic_uint registered;
+#else
+    unsigned registered;
+#endif
+    uint32_t max[_MG_IRQ_CPUS];
+    uint32_t histogram[_MG_IRQ_CPUS][MG_IRQ_BUCKETS];
+};
+
+struct mg_irq_stats_t {
+#ifdef MG_CPU_MAX
+    struct mg_irq_site_t* _Atomic sites;
+#else
+    struct mg_irq_site_t* sites;
+#endif
+    struct {
+        struct mg_irq_site_t* site;
+        uint32_t start;
+    } cpu[_MG_IRQ_CPUS];
+};
+
+extern struct mg_irq_stats_t g_mg_irq_stats;
+
+static inline void _mg_irq_register(struct mg_irq_site_t* site) {
+#ifdef MG_CPU_MAX
+    if (!atomic_load_explicit(&site->registered, memory_order_relaxed) &&
+        !atomic_exchange_explicit(&site->registered, 1, memory_order_relaxed)) {
+        site->next = atomic_load_explicit(&g_mg_irq_stats.sites, memory_order_relaxed);
+
+        while (!atomic_compare_exchange_weak_explicit(
+            &g_mg_irq_stats.sites,
+            &site->next,
+            site,
+            memory_order_release,
+            memory_order_relaxed)
+        ) {
+        }
+    }
+#else
+    if (!site->registered) {
+        site->registered = 1;
+        site->next = g_mg_irq_stats.sites;
+        g_mg_irq_stats.sites = site;
+    }
+#endif
+}
+
+/*
+ * Critical sections do not nest, so one start stamp per CPU is enough.
+ * Both functions are called with interrupts disabled.
+ */
+static inline void _mg_irq_start(struct mg_irq_site_t* site) {
+    const unsigned cpu = _mg_irq_cpu();
+    _mg_irq_register(site);
+    g_mg_irq_stats.cpu[cpu].site = site;
+    g_mg_irq_stats.cpu[cpu].start = mg_port_cycles();
+}
+
+static inline void _mg_irq_stop(void) {
+    const unsigned cpu = _mg_irq_cpu();
+    const uint32_t elapsed = mg_port_cycles() - g_mg_irq_stats.cpu[cpu].start;
+    struct mg_irq_site_t* const site = g_mg_irq_stats.cpu[cpu].site;
+    const unsigned msb = sizeof(uint32_t) * CHAR_BIT - 1 - mg_port_clz(elapsed | 1);
+    ++site->histogram[cpu][(msb < MG_IRQ_BUCKETS) ? msb : MG_IRQ_BUCKETS - 1];
+
+    if (elapsed > site->max[cpu]) {
+        site->max[cpu] = elapsed;
+    }
+}
+
+static inline struct mg_irq_site_t* mg_irq_sites(void) {
+#ifdef MG_CPU_MAX
+    return atomic_load_explicit(&g_mg_irq_stats.sites, memory_order_acquire);
+#else
+    return g_mg_irq_stats.sites;
+#endif
+}
+
+#   define _mg_irq_enter() do { \
+        static struct mg_irq_site_t _mg_irq_site = { \
+            .func = __func__, \
+            .line = __LINE__ \
+        }; \
+        mg_critical_section_enter(); \
+        _mg_irq_start(&_mg_irq_site); \
+    } while (0)
+#   define _mg_irq_leave() \
+        do { _mg_irq_stop(); mg_critical_section_leave(); } while (0)
+#else
+#   define _mg_irq_enter() mg_critical_section_enter()
+#   define _mg_irq_leave() mg_critical_section_leave()
+#endif
+
 #ifndef MG_CPU_MAX
 struct mg_smp_protect_t {
     unsigned int dummy;
@@ -22,8 +195,10 @@ struct mg_smp_protect_t {
 #   define MG_CPU_MAX 1
 #   define mg_cpu_this() 0
 #   define mg_smp_protect_init(s)
-#   define mg_smp_protect_acquire(s) mg_critical_section_enter()
-#   define mg_smp_protect_release(s) mg_critical_section_leave()
+#   define mg_smp_protect_acquire(s) \
+        do { _mg_irq_enter(); MG_TRACE_LOCK_ACQUIRE(s); } while (0)
+#   define mg_smp_protect_release(s) \
+        do { MG_TRACE_LOCK_RELEASE(s); _mg_irq_leave(); } while (0)
 #else
 #   include <stdatomic.h>
 
@@ -35,9 +210,7 @@ static inline void mg_smp_protect_init(struct mg_smp_protect_t* s) {
     atomic_init(&s->spinlock, 0);
 }
 
-static inline void mg_smp_protect_acquire(struct mg_smp_protect_t* s) {
-    mg_critical_section_enter();
-
+static inline void _mg_smp_protect_lock(struct mg_smp_protect_t* s) {
     while (!atomic_compare_exchange_weak_explicit(
         &s->spinlock, 
         &(unsigned) { 0 },
@@ -47,15 +220,41 @@ static inline void mg_smp_protect_acquire(struct mg_smp_protect_t* s) {
     ) {
         mg_port_wait_event();
     }
+
+    MG_TRACE_LOCK_ACQUIRE(s);
 }
 
+#ifdef MG_IRQ_STATS
+/*
+ * Acquisition is a macro so masked time of each call site, including time
+ * spent spinning, is accounted separately.
+ */
+#   define mg_smp_protect_acquire(s) \
+        do { _mg_irq_enter(); _mg_smp_protect_lock(s); } while (0)
+#else
+static inline void mg_smp_protect_acquire(struct mg_smp_protect_t* s) {
+    mg_critical_section_enter();
+    _mg_smp_protect_lock(s);
+}
+#endif
+
 static inline void mg_smp_protect_release(struct mg_smp_protect_t* s) {
+    MG_TRACE_LOCK_RELEASE(s);
     atomic_store_explicit(&s->spinlock, 0, memory_order_release);
     mg_port_send_event();
-    mg_critical_section_leave();
+    _mg_irq_leave();
 }
 #endif
 
+/*
+ * Activation and push stamps are subtracted on the CPU which runs the actor
+ * or pops the message, so per-core counters give garbage on SMP.
+ */
+#if (MG_CPU_MAX > 1) && (defined(MG_LATENCY_STATS) || defined(MG_MESSAGE_STATS)) && \
+    !defined(MG_PORT_CYCLES_GLOBAL)
+#error Latency and message stats on SMP need mg_port_cycles() synchronized between CPUs, define MG_PORT_CYCLES_GLOBAL.
+#endif
+
 struct mg_node_t {
     struct mg_node_t* next;
 };
@@ -92,10 +291,87 @@ static inline struct mg_node_t* mg_fifo_dequeue(struct mg_fifo_t* fifo) {
     return head;
 }
 
+static inline struct mg_node_t* mg_fifo_remove_next(
+    struct mg_fifo_t* fifo, 
+    struct mg_node_t* prev
+) {
+    struct mg_node_t* const node = prev->next;
+    prev->next = node->next;
+    if (node->next == 0)
+        fifo->tail = prev;
+    return node;
+}
+
+static inline void mg_fifo_splice(struct mg_fifo_t* fifo, struct mg_fifo_t* other) {
+    if (!mg_fifo_empty(other)) {
+        fifo->tail->next = other->dummy.next;
+        fifo->tail = other->tail;
+        mg_fifo_init(other);
+    }
+}
+
+#define MG_QUEUE_LOCAL_FIRST (1U << 0) /* Prefer subscribers on pushing CPU. */
+#ifdef MG_HANDOFF
+#define MG_QUEUE_HANDOFF (1U << 1) /* Run subscriber from current schedule loop. */
+
+#ifndef MG_HANDOFF_BURST
+#define MG_HANDOFF_BURST 4 /* Consecutive handoffs while runqueue is not empty. */
+#endif
+#endif
+#ifdef MG_QUEUE_BOUNDED
+#define MG_QUEUE_DROP_OLDEST (1U << 2) /* Full queue drops head instead of new. */
+#endif
+#define MG_QUEUE_LATCH (1U << 3) /* Notify without subscribers wakes the next one. */
+#define _MG_QUEUE_PENDING (1U << 31) /* Latched notification, internal. */
+
+struct mg_message_t;
+
+#ifdef MG_QUEUE_STATS
+struct mg_queue_stats_t {
+    uint32_t pushes;
+    uint32_t pops; /* Including messages passed directly to subscribers. */
+    uint32_t drops; /* Dropped or replaced due to capacity or custom put. */
+    uint32_t waits; /* Subscriptions of actors. */
+    int max_length; /* Message backlog high-water mark. */
+    int max_waiting; /* Waiting subscribers high-water mark. */
+};
+
+struct mg_pool_stats_t {
+    size_t unused; /* Blocks never allocated yet. */
+    size_t min_free; /* Free blocks low-water mark. */
+    uint32_t failures;
+};
+#endif
+
+#ifdef MG_MESSAGE_STATS
+#define MG_RESIDENCY_BUCKETS 32
+#endif
+
 struct mg_queue_t {
     struct mg_smp_protect_t lock;
     struct mg_fifo_t items;
     int length; /* Positive length - messages, negative - actors. */
+    unsigned flags;
+#ifdef MG_QUEUE_BOUNDED
+    int capacity; /* Zero means unbounded. */
+    struct mg_fifo_t producers; /* Actors waiting for space. */
+#endif
+#ifdef MG_QUEUE_HOOKS
+    struct mg_message_t* (*put)(struct mg_queue_t* q, struct mg_message_t* msg);
+    struct mg_message_t* (*get)(struct mg_queue_t* q); /* Custom order, may be NULL. */
+    struct mg_message_t* (*evict)(struct mg_queue_t* q); /* Victim of full queue. */
+#endif
+#ifdef MG_QUEUE_STATS
+    struct mg_queue_stats_t stats;
+#endif
+#ifdef MG_MESSAGE_STATS
+    uint32_t residency[MG_RESIDENCY_BUCKETS]; /* Time from push to delivery. */
+    uint32_t* lifetime; /* Histogram of the pool owning this queue, if any. */
+#endif
+#ifdef MG_REGISTRY
+    const char* name; /* Optional, for introspection tools. */
+    struct mg_node_t registry;
+#endif
 };
 
 struct mg_message_pool_t {
@@ -105,45 +381,275 @@ struct mg_message_pool_t {
     size_t block_sz;
     size_t offset;
     volatile bool array_space_available;
+    void (*release)(struct mg_message_t* msg); /* Custom free, may be NULL. */
+#ifdef MG_QUEUE_STATS
+    struct mg_pool_stats_t stats;
+#endif
+#ifdef MG_MESSAGE_STATS
+    uint32_t lifetime[MG_RESIDENCY_BUCKETS]; /* Time from alloc to free. */
+#endif
+#ifdef MG_REGISTRY
+    const char* name;
+    struct mg_node_t registry;
+#endif
 };
 
 struct mg_message_t {
     struct mg_message_pool_t* parent;
     struct mg_node_t link;
+#ifdef MG_MESSAGE_PRIO
+    unsigned prio; /* Zero after allocation. */
+#endif
+#ifdef MG_MESSAGE_STATS
+    uint32_t born; /* Time of allocation. */
+    uint32_t stamp; /* Time of the last push. */
+    unsigned hops; /* Number of pushes since allocation. */
+#endif
+};
+
+#ifdef MG_LATENCY_STATS
+#define MG_LATENCY_BUCKETS 32
+#endif
+
+struct mg_actor_t;
+
+#ifdef MG_WATCHDOG_TICKS
+#ifndef MG_WATCHDOG_ALARM
+#define MG_WATCHDOG_ALARM(actor, cpu, running)
+#endif
+
+/*
+ * Per-priority state of the stall detector. Flags prevent repeated reports
+ * of the same stall, they are cleared when the call ends or the runqueue
+ * head is taken.
+ */
+struct mg_watchdog_t {
+    struct mg_actor_t* volatile running; /* Actor called by schedule loop. */
+    volatile uint32_t started; /* Tick of the call start. */
+    volatile bool stalled; /* Running actor is reported. */
+    bool starved; /* Runqueue head is reported. */
+    unsigned depth; /* Actors in runqueue. */
+    unsigned max_depth;
+    uint32_t stalls;
+    uint32_t starvations;
 };
+#endif
+
+/*
+ * Running schedule loops are tracked only for features which look at them.
+ */
+#if defined(MG_HANDOFF) || (MG_CPU_MAX > 1)
+#define _MG_CONTEXT_ACTIVE
+#endif
 
 struct mg_cpu_context_t {
     struct mg_smp_protect_t lock;
     struct mg_fifo_t runq[MG_PRIO_MAX];
+#if MG_CPU_MAX > 1
+    struct mg_fifo_t shared[MG_PRIO_MAX]; /* Migratable actors. */
+#endif
     struct mg_fifo_t timerq[MG_TIMERQ_MAX];
+#ifdef MG_HANDOFF
+    struct mg_actor_t* volatile deferred[MG_PRIO_MAX];
+#endif
+#ifdef _MG_CONTEXT_ACTIVE
+    volatile unsigned active; /* Bitmask of running schedule loops. */
+#endif
     uint32_t ticks;
+#ifdef MG_LATENCY_STATS
+    uint32_t latency[MG_PRIO_MAX][MG_LATENCY_BUCKETS]; /* Log2 of cycles. */
+#endif
+#ifdef MG_ACTOR_STATS
+    uint32_t nested; /* Cycles of actors preempting the current one. */
+#endif
+#ifdef MG_WATCHDOG_TICKS
+    struct mg_watchdog_t watchdog[MG_PRIO_MAX];
+#endif
+};
+
+#define MG_ACTOR_MIGRATABLE (1U << 0) /* Actor may be stolen by other CPU. */
+
+#ifdef MG_ACTOR_STATS
+struct mg_actor_stats_t {
+    uint32_t activations;
+    uint32_t messages;
+    uint64_t cycles; /* Spent in actor function excluding preemption. */
+    uint32_t max_cycles; /* Longest single call. */
+    uint64_t preempted; /* Spent in nested higher-priority actors. */
 };
+#endif
 
 struct mg_actor_t {
     struct mg_queue_t* (*func)(struct mg_actor_t*, struct mg_message_t*);
     unsigned vect;
-    unsigned cpu;
+    volatile unsigned cpu;
     unsigned prio;
+    unsigned flags;
+#ifdef MG_MESSAGE_PRIO
+    const unsigned* vects; /* Vector per message priority, may be NULL. */
+    unsigned vect_count;
+#endif
     uint32_t timeout;
+#ifdef MG_LATENCY_STATS
+    uint32_t activated; /* Cycle counter at the last activation. */
+#endif
+#ifdef MG_ACTOR_STATS
+    struct mg_actor_stats_t stats;
+#endif
+#ifdef MG_WATCHDOG_TICKS
+    uint32_t queued; /* Tick of the last runqueue insertion. */
+#endif
+#ifdef MG_REGISTRY
+    const char* name;
+    struct mg_queue_t* volatile waiting; /* Queue the actor is blocked on. */
+    struct mg_node_t registry;
+#endif
     struct mg_message_t* mailbox;
+#ifdef MG_QUEUE_BOUNDED
+    struct mg_queue_t* target; /* Queue for pending push. */
+#endif
     struct mg_node_t link;
 };
 
+#ifdef MG_REGISTRY
+/*
+ * Objects are only added to the registry, so lists may be walked without 
+ * locking once the head is read under the lock. Lists are terminated by 
+ * _MG_REGISTRY_END rather than NULL, so zero link means the object is not
+ * registered yet.
+ */
+struct mg_registry_t {
+    struct mg_smp_protect_t lock;
+    struct mg_node_t* actors;
+    struct mg_node_t* queues;
+    struct mg_node_t* pools;
+};
+
+enum {
+    MG_ACTOR_RUNNABLE, /* Queued, running or preempted. */
+    MG_ACTOR_WAITING, /* Subscribed to a queue or waiting for space in it. */
+    MG_ACTOR_SLEEPING,
+};
+#endif
+
 struct mg_context_t {
     struct mg_cpu_context_t per_cpu_data[MG_CPU_MAX];
+#if MG_CPU_MAX > 1
+    atomic_uint migratable[MG_PRIO_MAX]; /* Actors in all shared runqueues. */
+#endif
+#ifdef MG_REGISTRY
+    struct mg_registry_t registry;
+#endif
 };
 
 extern struct mg_context_t g_mg_context;
 #define MG_CPU_CONTEXT(cpu) (&g_mg_context.per_cpu_data[cpu])
 #define MG_ACTOR_SUSPEND ((struct mg_queue_t*) 1)
+#ifdef MG_QUEUE_BOUNDED
+#define MG_ACTOR_PUSH ((struct mg_queue_t*) 2)
+#endif
 #define MG_ACTOR_START static int _mg_state = 0; switch(_mg_state) { case 0:
 #define MG_ACTOR_END } return NULL
 #define MG_AWAIT(q) _mg_state = __LINE__; return (q); case __LINE__:
 
+/*
+ * Free blocks are the ones in the pool queue and never allocated ones.
+ */
+static inline size_t mg_pool_free_count(const struct mg_message_pool_t* pool) {
+    const size_t queued = (pool->queue.length > 0) ? (size_t) pool->queue.length : 0;
+    const size_t unused = pool->array_space_available ? 
+        (pool->total_length - pool->offset) / pool->block_sz : 0;
+    return queued + unused;
+}
+
+#ifdef MG_REGISTRY
+#define _MG_REGISTRY_END ((struct mg_node_t*) &g_mg_context.registry)
+
+/*
+ * Repeated initialization of the same object does not add it twice. Objects
+ * must be zero-initialized before the first one, i.e. have static storage.
+ */
+static inline void _mg_registry_add(struct mg_node_t** list, struct mg_node_t* node) {
+    mg_smp_protect_acquire(&g_mg_context.registry.lock);
+
+    if (node->next == 0) {
+        node->next = *list;
+        *list = node;
+    }
+
+    mg_smp_protect_release(&g_mg_context.registry.lock);
+}
+
+static inline struct mg_node_t* _mg_registry_next(
+    struct mg_node_t** list, 
+    struct mg_node_t* node
+) {
+    struct mg_node_t* next = 0;
+
+    if (node) {
+        next = node->next;
+    } else {
+        mg_smp_protect_acquire(&g_mg_context.registry.lock);
+        next = *list;
+        mg_smp_protect_release(&g_mg_context.registry.lock);
+    }
+
+    return (next != _MG_REGISTRY_END) ? next : 0;
+}
+
+#define _mg_registry_entry(node, type) \
+    ((node) ? mg_fifo_entry((node), type, registry) : 0)
+
+/*
+ * Iteration over registered objects, NULL argument returns the first one.
+ */
+static inline struct mg_actor_t* mg_registry_next_actor(struct mg_actor_t* actor) {
+    struct mg_node_t* const node = 
+        _mg_registry_next(&g_mg_context.registry.actors, actor ? &actor->registry : 0);
+    return _mg_registry_entry(node, struct mg_actor_t);
+}
+
+static inline struct mg_queue_t* mg_registry_next_queue(struct mg_queue_t* q) {
+    struct mg_node_t* const node = 
+        _mg_registry_next(&g_mg_context.registry.queues, q ? &q->registry : 0);
+    return _mg_registry_entry(node, struct mg_queue_t);
+}
+
+static inline struct mg_message_pool_t* mg_registry_next_pool(
+    struct mg_message_pool_t* pool
+) {
+    struct mg_node_t* const node = 
+        _mg_registry_next(&g_mg_context.registry.pools, pool ? &pool->registry : 0);
+    return _mg_registry_entry(node, struct mg_message_pool_t);
+}
+
+/*
+ * State is derived from fields written by other CPUs without locking, so it
+ * may be already outdated when returned.
+ */
+static inline unsigned mg_actor_state(const struct mg_actor_t* actor) {
+    if (actor->waiting) {
+        return MG_ACTOR_WAITING;
+    }
+
+    return actor->timeout ? MG_ACTOR_SLEEPING : MG_ACTOR_RUNNABLE;
+}
+
+#define _mg_actor_waits(actor, q) ((actor)->waiting = (q))
+#else
+#define _mg_actor_waits(actor, q)
+#endif
+
 static inline void mg_context_init(void) {
     for (unsigned cpu = 0; cpu < MG_CPU_MAX; ++cpu) {
         struct mg_cpu_context_t* const self = MG_CPU_CONTEXT(cpu);
         self->ticks = 0;
+#ifdef _MG_CONTEXT_ACTIVE
+        self->active = 0;
+#endif
+#ifdef MG_ACTOR_STATS
+        self->nested = 0;
+#endif
         mg_smp_protect_init(&self->lock);
         
         for (size_t i = 0; i < MG_TIMERQ_MAX; ++i) {
@@ -152,14 +658,67 @@ static inline void mg_context_init(void) {
 
         for (size_t i = 0; i < MG_PRIO_MAX; ++i) {
             mg_fifo_init(&self->runq[i]);
+#if MG_CPU_MAX > 1
+            mg_fifo_init(&self->shared[i]);
+#endif
+#ifdef MG_HANDOFF
+            self->deferred[i] = 0;
+#endif
+#ifdef MG_LATENCY_STATS
+            for (size_t j = 0; j < MG_LATENCY_BUCKETS; ++j) {
+                self->latency[i][j] = 0;
+            }
+#endif
+#ifdef MG_WATCHDOG_TICKS
+            self->watchdog[i] = (struct mg_watchdog_t) { 0 };
+#endif
         }
     }
+#if MG_CPU_MAX > 1
+    for (size_t i = 0; i < MG_PRIO_MAX; ++i) {
+        atomic_init(&g_mg_context.migratable[i], 0);
+    }
+#endif
+#ifdef MG_REGISTRY
+    mg_smp_protect_init(&g_mg_context.registry.lock);
+    g_mg_context.registry.actors = _MG_REGISTRY_END;
+    g_mg_context.registry.queues = _MG_REGISTRY_END;
+    g_mg_context.registry.pools = _MG_REGISTRY_END;
+#endif
 }
 
-static inline void mg_queue_init(struct mg_queue_t* q) {
+static inline void _mg_queue_init(struct mg_queue_t* q) {
     mg_fifo_init(&q->items);
     mg_smp_protect_init(&q->lock);
     q->length = 0;
+    q->flags = 0;
+#ifdef MG_QUEUE_BOUNDED
+    q->capacity = 0;
+    mg_fifo_init(&q->producers);
+#endif
+#ifdef MG_QUEUE_HOOKS
+    q->put = 0;
+    q->get = 0;
+    q->evict = 0;
+#endif
+#ifdef MG_QUEUE_STATS
+    q->stats = (struct mg_queue_stats_t) { 0 };
+#endif
+#ifdef MG_MESSAGE_STATS
+    for (unsigned i = 0; i < MG_RESIDENCY_BUCKETS; ++i) {
+        q->residency[i] = 0;
+    }
+
+    q->lifetime = 0;
+#endif
+}
+
+static inline void mg_queue_init(struct mg_queue_t* q) {
+    _mg_queue_init(q);
+#ifdef MG_REGISTRY
+    q->name = 0;
+    _mg_registry_add(&g_mg_context.registry.queues, &q->registry);
+#endif
 }
 
 static inline void mg_message_pool_init(
@@ -170,109 +729,868 @@ static inline void mg_message_pool_init(
 ) {
     assert(total_len >= block_sz);
     assert(block_sz >= sizeof(struct mg_message_t));
-    mg_queue_init(&pool->queue);
+    _mg_queue_init(&pool->queue);
     pool->array = mem;
     pool->total_length = total_len;
     pool->block_sz = block_sz;
     pool->offset = 0;
     pool->array_space_available = true;
+    pool->release = 0;
+#ifdef MG_QUEUE_STATS
+    pool->stats.unused = total_len / block_sz;
+    pool->stats.min_free = pool->stats.unused;
+    pool->stats.failures = 0;
+#endif
+#ifdef MG_MESSAGE_STATS
+    for (unsigned i = 0; i < MG_RESIDENCY_BUCKETS; ++i) {
+        pool->lifetime[i] = 0;
+    }
+
+    pool->queue.lifetime = pool->lifetime;
+#endif
+#ifdef MG_REGISTRY
+    pool->name = 0;
+    _mg_registry_add(&g_mg_context.registry.pools, &pool->registry);
+#endif
 }
 
-static inline void _mg_actor_insert(struct mg_actor_t* actor) {
-    assert(actor->cpu < MG_CPU_MAX);
-    struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(actor->cpu);
+static inline unsigned _mg_actor_insert(struct mg_actor_t* actor) {
+    const unsigned cpu = actor->cpu;
+    assert(cpu < MG_CPU_MAX);
+    struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(cpu);
+    struct mg_fifo_t* runq = &context->runq[actor->prio];
+#if MG_CPU_MAX > 1
+    if (actor->flags & MG_ACTOR_MIGRATABLE) {
+        runq = &context->shared[actor->prio];
+    }
+#endif
+#ifdef MG_LATENCY_STATS
+    actor->activated = mg_port_cycles();
+#endif
     mg_smp_protect_acquire(&context->lock);
-    mg_fifo_enqueue(&context->runq[actor->prio], &actor->link);
+    mg_fifo_enqueue(runq, &actor->link);
+#if MG_CPU_MAX > 1
+    if (runq != &context->runq[actor->prio]) {
+        atomic_fetch_add_explicit(&g_mg_context.migratable[actor->prio], 1, memory_order_relaxed);
+    }
+#endif
+#ifdef MG_WATCHDOG_TICKS
+    struct mg_watchdog_t* const wd = &context->watchdog[actor->prio];
+    actor->queued = context->ticks;
+
+    if (++wd->depth > wd->max_depth) {
+        wd->max_depth = wd->depth;
+    }
+#endif
     mg_smp_protect_release(&context->lock);
+    return cpu;
 }
 
-static inline void _mg_actor_activate(struct mg_actor_t* actor) {
-    _mg_actor_insert(actor);
-    pic_interrupt_request(actor->cpu, actor->vect);
-}
+#if MG_CPU_MAX > 1
+/*
+ * When the owner CPU is busy at the priority of migratable actor being
+ * activated, some idle CPU is requested to run the same vector. It finds 
+ * its own runqueue empty and steals the actor.
+ */
+static inline void _mg_context_kick_idle(unsigned owner, unsigned vect) {
+    const unsigned prio = pic_vect2prio(vect);
 
-static inline struct mg_message_t* mg_queue_pop(
-    struct mg_queue_t* q, 
-    struct mg_actor_t* subscriber
-) {
-    struct mg_message_t* msg = 0;
-    mg_smp_protect_acquire(&q->lock);
+    if ((MG_CPU_CONTEXT(owner)->active & (1U << prio)) == 0) {
+        return;
+    }
 
-    if (q->length > 0) {
-        struct mg_node_t* const head = mg_fifo_dequeue(&q->items);
-        msg = mg_fifo_entry(head, struct mg_message_t, link);
-        --q->length;
-    } else if (subscriber != 0) {
-        mg_fifo_enqueue(&q->items, &subscriber->link);
-        --q->length;
+    for (unsigned cpu = 0; cpu < MG_CPU_MAX; ++cpu) {
+        if ((cpu != owner) && (MG_CPU_CONTEXT(cpu)->active == 0)) {
+            pic_interrupt_request(cpu, vect);
+            break;
+        }
     }
+}
+#endif
 
-    mg_smp_protect_release(&q->lock);
-    return msg;
+static inline void _mg_actor_activate(struct mg_actor_t* actor) {
+    const unsigned vect = actor->vect;
+    const unsigned cpu = _mg_actor_insert(actor);
+    MG_TRACE_ACTOR_ACTIVATE(actor, cpu, vect);
+    pic_interrupt_request(cpu, vect);
+#if MG_CPU_MAX > 1
+    if (actor->flags & MG_ACTOR_MIGRATABLE) {
+        _mg_context_kick_idle(cpu, vect);
+    }
+#endif
 }
 
-static inline void mg_queue_push(
-    struct mg_queue_t* q, 
-    struct mg_message_t* msg
-) {
-    struct mg_actor_t* actor = 0;
-    mg_smp_protect_acquire(&q->lock);
+#ifdef MG_HANDOFF
+/*
+ * Actor may be passed directly to the schedule loop of the same priority 
+ * running on this CPU. It is executed once the current actor completes, so 
+ * neither runqueue nor interrupt request are needed.
+ */
+static inline bool _mg_actor_defer(struct mg_actor_t* actor) {
+    const unsigned cpu = mg_cpu_this();
+    
+    if (actor->cpu != cpu) {
+        return false;
+    }
 
-    if (q->length++ >= 0) {
-        mg_fifo_enqueue(&q->items, &msg->link);
-    } else {
-        struct mg_node_t* const head = mg_fifo_dequeue(&q->items);
-        actor = mg_fifo_entry(head, struct mg_actor_t, link);
-        actor->mailbox = msg;    
+    struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(cpu);
+    bool deferred = false;
+    _mg_irq_enter();
+
+    if ((context->active & (1U << actor->prio)) && !context->deferred[actor->prio]) {
+#ifdef MG_LATENCY_STATS
+        actor->activated = mg_port_cycles();
+#endif
+        context->deferred[actor->prio] = actor;
+        deferred = true;
     }
 
-    mg_smp_protect_release(&q->lock);
+    _mg_irq_leave();
 
-    if (actor) {
-        _mg_actor_activate(actor);
+    if (deferred) {
+        MG_TRACE_ACTOR_ACTIVATE(actor, cpu, actor->vect);
     }
-}
 
-static inline void* mg_message_alloc(struct mg_message_pool_t* pool) {
-    struct mg_message_t* msg = 0;
+    return deferred;
+}
+#endif
 
-    if (pool->array_space_available) {
-        mg_smp_protect_acquire(&pool->queue.lock);
-
-        if (pool->array_space_available) {
-            msg = (void*)(pool->array + pool->offset);
-            msg->parent = pool;
-            pool->offset += pool->block_sz;
-            pool->array_space_available = 
-                ((pool->offset + pool->block_sz) <= pool->total_length);
-        }
+#ifdef MG_MESSAGE_PRIO
+#define _mg_message_reset_prio(msg) ((msg)->prio = 0)
 
-        mg_smp_protect_release(&pool->queue.lock);
+/*
+ * Actor bound to several vectors runs at the one selected by priority of the
+ * received message, empty messages keep the current one. Returns true if the
+ * vector was changed.
+ */
+static inline bool _mg_actor_retarget(
+    struct mg_actor_t* actor, 
+    struct mg_message_t* msg
+) {
+    if ((actor->vects == 0) || (msg == 0)) {
+        return false;
     }
 
-    if (!msg) {
-        msg = mg_queue_pop(&pool->queue, 0);
-    }  
+    const unsigned level = 
+        (msg->prio < actor->vect_count) ? msg->prio : (actor->vect_count - 1);
+    const unsigned vect = actor->vects[level];
 
-    return msg;
-}
+    if (vect == actor->vect) {
+        return false;
+    }
 
-static inline void mg_message_free(struct mg_message_t* msg) {
-    struct mg_message_pool_t* const pool = msg->parent;
-    mg_queue_push(&pool->queue, msg);
+    actor->vect = vect;
+    actor->prio = pic_vect2prio(vect);
+    return true;
+}
+#else
+#define _mg_message_reset_prio(msg)
+
+static inline bool _mg_actor_retarget(
+    struct mg_actor_t* actor, 
+    struct mg_message_t* msg
+) {
+    (void) actor;
+    (void) msg;
+    return false;
+}
+#endif
+
+static inline unsigned _mg_msb(uint32_t x) {
+    return sizeof(uint32_t) * CHAR_BIT - 1 - mg_port_clz(x);
+}
+
+static inline unsigned _mg_lsb(uint32_t x) {
+    return _mg_msb(x & (~x + 1));
+}
+
+#ifdef MG_QUEUE_STATS
+/*
+ * Called under the queue lock after length is updated.
+ */
+static inline void _mg_queue_account(
+    struct mg_queue_t* q, 
+    uint32_t pushes, 
+    uint32_t pops
+) {
+    q->stats.pushes += pushes;
+    q->stats.pops += pops;
+
+    if (q->length > q->stats.max_length) {
+        q->stats.max_length = q->length;
+    } else if (-q->length > q->stats.max_waiting) {
+        q->stats.max_waiting = -q->length;
+    }
+}
+
+static inline void _mg_pool_account(struct mg_message_pool_t* pool, size_t allocated) {
+    const size_t free = mg_pool_free_count(pool);
+    _mg_queue_account(&pool->queue, 0, 0);
+    pool->queue.stats.pops += allocated;
+
+    if (free < pool->stats.min_free) {
+        pool->stats.min_free = free;
+    }
+}
+#else
+#define _mg_queue_account(q, pushes, pops)
+#define _mg_pool_account(pool, allocated)
+#endif
+
+#ifdef MG_MESSAGE_STATS
+static inline void _mg_message_born(struct mg_message_t* msg) {
+    msg->born = mg_port_cycles();
+    msg->stamp = msg->born;
+    msg->hops = 0;
+}
+
+static inline void _mg_message_stamp(struct mg_message_t* msg) {
+    msg->stamp = mg_port_cycles();
+    ++msg->hops;
+}
+
+/*
+ * Called under the queue lock when the message is popped or passed directly
+ * to a waiting subscriber.
+ */
+static inline void _mg_queue_delivered(struct mg_queue_t* q, struct mg_message_t* msg) {
+    ++q->residency[_mg_msb((mg_port_cycles() - msg->stamp) | 1)];
+}
+
+/*
+ * Called under the lock of the push which returns messages to their pool, the
+ * stamp of that push is the time of free.
+ */
+static inline void _mg_queue_retired(struct mg_queue_t* q, struct mg_message_t* msg) {
+    if (q->lifetime) {
+        ++q->lifetime[_mg_msb((msg->stamp - msg->born) | 1)];
+    }
+}
+
+static inline void _mg_queue_retired_chain(struct mg_queue_t* q, struct mg_fifo_t* chain) {
+    if (q->lifetime) {
+        for (struct mg_node_t* p = chain->dummy.next; p != 0; p = p->next) {
+            _mg_queue_retired(q, mg_fifo_entry(p, struct mg_message_t, link));
+        }
+    }
+}
+#else
+#define _mg_message_born(msg)
+#define _mg_message_stamp(msg)
+#define _mg_queue_delivered(q, msg)
+#define _mg_queue_retired(q, msg)
+#define _mg_queue_retired_chain(q, chain)
+#endif
+
+/*
+ * Full bounded queue without MG_QUEUE_DROP_OLDEST has no room for one more
+ * message. Put hooks are still called, since replacing a pending message
+ * does not grow the queue, but must return the new message instead of
+ * appending it.
+ */
+static inline bool _mg_queue_refuses(struct mg_queue_t* q) {
+#ifdef MG_QUEUE_BOUNDED
+    return (q->capacity != 0) && (q->length >= q->capacity) && 
+        !(q->flags & MG_QUEUE_DROP_OLDEST);
+#else
+    (void) q;
+    return false;
+#endif
+}
+
+/*
+ * Queues with custom put/get functions keep messages in their own storage,
+ * the items list is used for subscribers only. Put returns a message pushed
+ * out of the queue instead of the new one, if any.
+ */
+static inline struct mg_message_t* _mg_queue_put(
+    struct mg_queue_t* q, 
+    struct mg_message_t* msg
+) {
+#ifdef MG_QUEUE_HOOKS
+    if (q->put) {
+        return q->put(q, msg);
+    }
+#endif
+    mg_fifo_enqueue(&q->items, &msg->link);
+    return 0;
+}
+
+static inline struct mg_message_t* _mg_queue_get(struct mg_queue_t* q) {
+#ifdef MG_QUEUE_HOOKS
+    if (q->get) {
+        return q->get(q);
+    }
+#endif
+    struct mg_node_t* const head = mg_fifo_dequeue(&q->items);
+    return mg_fifo_entry(head, struct mg_message_t, link);
+}
+
+#ifdef MG_QUEUE_BOUNDED
+/*
+ * Message dropped from full queue with MG_QUEUE_DROP_OLDEST. Queues with
+ * custom order may choose the least important one instead of the next one
+ * to be delivered.
+ */
+static inline struct mg_message_t* _mg_queue_evict(struct mg_queue_t* q) {
+#ifdef MG_QUEUE_HOOKS
+    if (q->evict) {
+        return q->evict(q);
+    }
+#endif
+    return _mg_queue_get(q);
+}
+#endif
+
+/*
+ * Stores the message into the queue without waiting subscribers. Returns the
+ * message dropped due to capacity limit, if any.
+ */
+static inline struct mg_message_t* _mg_queue_store(
+    struct mg_queue_t* q, 
+    struct mg_message_t* msg
+) {
+#ifdef MG_QUEUE_BOUNDED
+    const bool full = (q->capacity != 0) && (q->length >= q->capacity);
+    bool accepts = !_mg_queue_refuses(q);
+    struct mg_message_t* dropped = msg;
+#ifdef MG_QUEUE_HOOKS
+    accepts = accepts || (q->put != 0);
+#endif
+
+    if (accepts) {
+        dropped = _mg_queue_put(q, msg);
+
+        if (dropped == 0) {
+            if (full) {
+                assert(q->flags & MG_QUEUE_DROP_OLDEST);
+                dropped = _mg_queue_evict(q);
+            } else {
+                ++q->length;
+            }
+        }
+    }
+#else
+    struct mg_message_t* const dropped = _mg_queue_put(q, msg);
+
+    if (dropped == 0) {
+        ++q->length;
+    }
+#endif
+#ifdef MG_QUEUE_STATS
+    q->stats.drops += (dropped != 0);
+#endif
+    return dropped;
+}
+
+static inline void mg_message_free(struct mg_message_t* msg);
+
+static inline void _mg_queue_wake(struct mg_queue_t* q, struct mg_actor_t* actor) {
+    _mg_actor_retarget(actor, actor->mailbox);
+#ifdef MG_HANDOFF
+    if ((q->flags & MG_QUEUE_HANDOFF) && _mg_actor_defer(actor)) {
+        return;
+    }
+#else
+    (void) q;
+#endif
+    _mg_actor_activate(actor);
+}
+
+/*
+ * When a message is taken from a full bounded queue the first waiting producer
+ * gets its message moved into the queue and is activated.
+ */
+static inline struct mg_message_t* mg_queue_pop(
+    struct mg_queue_t* q, 
+    struct mg_actor_t* subscriber
+) {
+    struct mg_message_t* msg = 0;
+    struct mg_message_t* dropped = 0;
+    struct mg_actor_t* producer = 0;
+    struct mg_actor_t* notified = 0;
+    mg_smp_protect_acquire(&q->lock);
+
+    if (q->length > 0) {
+        msg = _mg_queue_get(q);
+        --q->length;
+        MG_TRACE_QUEUE_POP(q, msg);
+        _mg_queue_delivered(q, msg);
+#ifdef MG_QUEUE_BOUNDED
+        if (!mg_fifo_empty(&q->producers)) {
+            struct mg_node_t* const next = mg_fifo_dequeue(&q->producers);
+            producer = mg_fifo_entry(next, struct mg_actor_t, link);
+            _mg_actor_waits(producer, 0);
+            dropped = _mg_queue_store(q, producer->mailbox);
+            producer->mailbox = 0;
+        }
+#endif
+    } else if ((subscriber != 0) && (q->flags & _MG_QUEUE_PENDING)) {
+        q->flags &= ~_MG_QUEUE_PENDING;
+        subscriber->mailbox = 0;
+        notified = subscriber;
+    } else if (subscriber != 0) {
+        mg_fifo_enqueue(&q->items, &subscriber->link);
+        --q->length;
+        _mg_actor_waits(subscriber, q);
+        MG_TRACE_QUEUE_SUBSCRIBE(q, subscriber);
+#ifdef MG_QUEUE_STATS
+        ++q->stats.waits;
+#endif
+    }
+
+    _mg_queue_account(q, (producer != 0), (msg != 0));
+    mg_smp_protect_release(&q->lock);
+
+    if (producer) {
+        _mg_actor_activate(producer);
+    }
+
+    if (notified) {
+        _mg_queue_wake(q, notified);
+    }
+
+    if (dropped) {
+        mg_message_free(dropped);
+    }
+
+    return msg;
+}
+
+static inline struct mg_actor_t* _mg_queue_take_subscriber(struct mg_queue_t* q) {
+    struct mg_actor_t* actor = 0;
+
+    if (q->flags & MG_QUEUE_LOCAL_FIRST) {
+        const unsigned cpu = mg_cpu_this();
+
+        for (struct mg_node_t* p = &q->items.dummy; p->next != 0; p = p->next) {
+            struct mg_actor_t* const candidate = 
+                mg_fifo_entry(p->next, struct mg_actor_t, link);
+
+            if (candidate->cpu == cpu) {
+                mg_fifo_remove_next(&q->items, p);
+                actor = candidate;
+                break;
+            }
+        }
+    }
+
+    if (!actor) {
+        struct mg_node_t* const head = mg_fifo_dequeue(&q->items);
+        actor = mg_fifo_entry(head, struct mg_actor_t, link);
+    }
+
+    _mg_actor_waits(actor, 0);
+    return actor;
+}
+
+static inline void mg_queue_push(
+    struct mg_queue_t* q, 
+    struct mg_message_t* msg
+) {
+    struct mg_actor_t* actor = 0;
+    struct mg_message_t* dropped = 0;
+    MG_TRACE_QUEUE_PUSH(q, msg);
+    _mg_message_stamp(msg);
+    mg_smp_protect_acquire(&q->lock);
+    _mg_queue_retired(q, msg);
+
+    if (q->length >= 0) {
+        dropped = _mg_queue_store(q, msg);
+    } else {
+        actor = _mg_queue_take_subscriber(q);
+        actor->mailbox = msg;
+        ++q->length;
+        _mg_queue_delivered(q, msg);
+    }
+
+    _mg_queue_account(q, 1, (actor != 0));
+    mg_smp_protect_release(&q->lock);
+
+    if (actor) {
+        _mg_queue_wake(q, actor);
+    }
+
+    if (dropped) {
+        mg_message_free(dropped);
+    }
+}
+
+/*
+ * Activates one waiting subscriber, if any, with empty message. Queues with
+ * MG_QUEUE_LATCH remember notification sent while nobody was waiting and the
+ * next subscriber is activated instead of being queued.
+ */
+static inline void mg_queue_notify(struct mg_queue_t* q) {
+    struct mg_actor_t* actor = 0;
+    mg_smp_protect_acquire(&q->lock);
+
+    if (q->length < 0) {
+        actor = _mg_queue_take_subscriber(q);
+        actor->mailbox = 0;
+        ++q->length;
+    } else if (q->flags & MG_QUEUE_LATCH) {
+        q->flags |= _MG_QUEUE_PENDING;
+    }
+
+    mg_smp_protect_release(&q->lock);
+
+    if (actor) {
+        _mg_queue_wake(q, actor);
+    }
+}
+
+/*
+ * Messages of unbounded queue without custom storage may be appended to the
+ * items list directly.
+ */
+static inline bool _mg_queue_plain(struct mg_queue_t* q) {
+    bool plain = true;
+#ifdef MG_QUEUE_BOUNDED
+    plain = plain && (q->capacity == 0);
+#endif
+#ifdef MG_QUEUE_HOOKS
+    plain = plain && (q->put == 0);
+#endif
+    (void) q;
+    return plain;
+}
+
+/*
+ * Pushes the whole chain of messages under single lock acquisition. Waiting 
+ * subscribers receive one message each, the rest is appended to the queue.
+ */
+static inline void mg_queue_push_chain(
+    struct mg_queue_t* q, 
+    struct mg_fifo_t* chain
+) {
+    struct mg_fifo_t woken;
+    mg_fifo_init(&woken);
+    int n = 0;
+
+    for (struct mg_node_t* p = chain->dummy.next; p != 0; p = p->next) {
+        MG_TRACE_QUEUE_PUSH(q, mg_fifo_entry(p, struct mg_message_t, link));
+        _mg_message_stamp(mg_fifo_entry(p, struct mg_message_t, link));
+        ++n;
+    }
+
+    mg_smp_protect_acquire(&q->lock);
+    _mg_queue_retired_chain(q, chain);
+
+    while ((q->length < 0) && !mg_fifo_empty(chain)) {
+        struct mg_actor_t* const actor = _mg_queue_take_subscriber(q);
+        struct mg_node_t* const head = mg_fifo_dequeue(chain);
+        actor->mailbox = mg_fifo_entry(head, struct mg_message_t, link);
+        mg_fifo_enqueue(&woken, &actor->link);
+        ++q->length;
+        --n;
+        _mg_queue_delivered(q, actor->mailbox);
+        _mg_queue_account(q, 1, 1);
+    }
+
+    struct mg_fifo_t dropped;
+    mg_fifo_init(&dropped);
+
+    if (_mg_queue_plain(q)) {
+        mg_fifo_splice(&q->items, chain);
+        q->length += n;
+    } else {
+        while (!mg_fifo_empty(chain)) {
+            struct mg_node_t* const head = mg_fifo_dequeue(chain);
+            struct mg_message_t* const msg = 
+                _mg_queue_store(q, mg_fifo_entry(head, struct mg_message_t, link));
+
+            if (msg) {
+                mg_fifo_enqueue(&dropped, &msg->link);
+            }
+        }
+    }
+
+    _mg_queue_account(q, (uint32_t) n, 0);
+    mg_smp_protect_release(&q->lock);
+
+    while (!mg_fifo_empty(&woken)) {
+        struct mg_node_t* const head = mg_fifo_dequeue(&woken);
+        _mg_queue_wake(q, mg_fifo_entry(head, struct mg_actor_t, link));
+    }
+
+    while (!mg_fifo_empty(&dropped)) {
+        struct mg_node_t* const head = mg_fifo_dequeue(&dropped);
+        mg_message_free(mg_fifo_entry(head, struct mg_message_t, link));
+    }
+}
+
+#ifdef MG_QUEUE_BOUNDED
+/*
+ * Called from actor function as MG_AWAIT(mg_queue_push_await(q, msg, self)).
+ * The push is completed by the kernel after the function returns: if bounded
+ * queue is full the actor is suspended until a consumer frees the space. In
+ * both cases the actor is resumed with empty message.
+ */
+static inline struct mg_queue_t* mg_queue_push_await(
+    struct mg_queue_t* q, 
+    struct mg_message_t* msg,
+    struct mg_actor_t* self
+) {
+    self->target = q;
+    self->mailbox = msg;
+    return MG_ACTOR_PUSH;
+}
+
+/*
+ * Returns false if the actor was parked, it must not be touched after that.
+ */
+static inline bool _mg_queue_push_or_park(struct mg_actor_t* producer) {
+    struct mg_queue_t* const q = producer->target;
+    struct mg_message_t* const msg = producer->mailbox;
+    struct mg_actor_t* actor = 0;
+    struct mg_message_t* dropped = 0;
+    bool parked = false;
+    MG_TRACE_QUEUE_PUSH(q, msg);
+    _mg_message_stamp(msg);
+    mg_smp_protect_acquire(&q->lock);
+
+    if (q->length < 0) {
+        actor = _mg_queue_take_subscriber(q);
+        actor->mailbox = msg;
+        ++q->length;
+        _mg_queue_delivered(q, msg);
+    } else if ((q->capacity == 0) || (q->length < q->capacity)) {
+        dropped = _mg_queue_store(q, msg);
+    } else {
+        mg_fifo_enqueue(&q->producers, &producer->link);
+        _mg_actor_waits(producer, q);
+        parked = true;
+    }
+
+    _mg_queue_account(q, !parked, (actor != 0));
+    mg_smp_protect_release(&q->lock);
+
+    if (actor) {
+        _mg_queue_wake(q, actor);
+    }
+
+    if (dropped) {
+        mg_message_free(dropped);
+    }
+
+    if (!parked) {
+        producer->mailbox = 0;
+    }
+
+    return !parked;
+}
+#endif
+
+/*
+ * Pool queues never have custom storage or waiting producers, so the message
+ * is taken either from the array or from the queue under single lock.
+ */
+static inline void* mg_message_alloc(struct mg_message_pool_t* pool) {
+    struct mg_message_t* msg = 0;
+    mg_smp_protect_acquire(&pool->queue.lock);
+
+    if (pool->array_space_available) {
+        msg = (void*)(pool->array + pool->offset);
+        msg->parent = pool;
+        _mg_message_reset_prio(msg);
+        pool->offset += pool->block_sz;
+        pool->array_space_available = 
+            ((pool->offset + pool->block_sz) <= pool->total_length);
+#ifdef MG_QUEUE_STATS
+        --pool->stats.unused;
+#endif
+    } else if (pool->queue.length > 0) {
+        struct mg_node_t* const head = mg_fifo_dequeue(&pool->queue.items);
+        msg = mg_fifo_entry(head, struct mg_message_t, link);
+        --pool->queue.length;
+        MG_TRACE_QUEUE_POP(&pool->queue, msg);
+        _mg_queue_delivered(&pool->queue, msg);
+    }
+#ifdef MG_QUEUE_STATS
+    pool->stats.failures += (msg == 0);
+#endif
+    _mg_pool_account(pool, (msg != 0));
+    mg_smp_protect_release(&pool->queue.lock);
+
+    if (msg) {
+        _mg_message_born(msg);
+        MG_TRACE_POOL_ALLOC(pool, msg);
+    } else {
+        MG_TRACE_POOL_EMPTY(pool);
+    }
+
+    return msg;
+}
+
+/*
+ * Allocates up to n messages linked into the chain under single lock 
+ * acquisition. Returns number of messages actually allocated.
+ */
+static inline size_t mg_message_alloc_n(
+    struct mg_message_pool_t* pool, 
+    struct mg_fifo_t* chain, 
+    size_t n
+) {
+    size_t count = 0;
+    mg_smp_protect_acquire(&pool->queue.lock);
+
+    for (; (count < n) && pool->array_space_available; ++count) {
+        struct mg_message_t* const msg = (void*)(pool->array + pool->offset);
+        msg->parent = pool;
+        _mg_message_reset_prio(msg);
+        _mg_message_born(msg);
+        MG_TRACE_POOL_ALLOC(pool, msg);
+        mg_fifo_enqueue(chain, &msg->link);
+        pool->offset += pool->block_sz;
+        pool->array_space_available = 
+            ((pool->offset + pool->block_sz) <= pool->total_length);
+#ifdef MG_QUEUE_STATS
+        --pool->stats.unused;
+#endif
+    }
+
+    for (; (count < n) && (pool->queue.length > 0); ++count) {
+        struct mg_node_t* const head = mg_fifo_dequeue(&pool->queue.items);
+        struct mg_message_t* const msg = mg_fifo_entry(head, struct mg_message_t, link);
+        MG_TRACE_QUEUE_POP(&pool->queue, msg);
+        _mg_queue_delivered(&pool->queue, msg);
+        _mg_message_born(msg);
+        MG_TRACE_POOL_ALLOC(pool, msg);
+        mg_fifo_enqueue(chain, &msg->link);
+        --pool->queue.length;
+    }
+
+    if (count < n) {
+        MG_TRACE_POOL_EMPTY(pool);
+    }
+#ifdef MG_QUEUE_STATS
+    pool->stats.failures += (count < n);
+#endif
+    _mg_pool_account(pool, count);
+
+    mg_smp_protect_release(&pool->queue.lock);
+    return count;
+}
+
+static inline void mg_message_free(struct mg_message_t* msg) {
+    struct mg_message_pool_t* const pool = msg->parent;
+    _mg_message_reset_prio(msg);
+    MG_TRACE_POOL_FREE(pool, msg);
+
+    if (pool->release) {
+        pool->release(msg);
+    } else {
+        mg_queue_push(&pool->queue, msg);
+    }
+}
+
+/*
+ * All messages in the chain must belong to the same pool.
+ */
+static inline void mg_message_free_n(struct mg_fifo_t* chain) {
+    if (mg_fifo_empty(chain)) {
+        return;
+    }
+
+    struct mg_message_pool_t* const pool = 
+        mg_fifo_entry(chain->dummy.next, struct mg_message_t, link)->parent;
+
+    for (struct mg_node_t* p = chain->dummy.next; p != 0; p = p->next) {
+        struct mg_message_t* const msg = mg_fifo_entry(p, struct mg_message_t, link);
+        assert(msg->parent == pool);
+        _mg_message_reset_prio(msg);
+        MG_TRACE_POOL_FREE(pool, msg);
+    }
+
+    if (pool->release) {
+        while (!mg_fifo_empty(chain)) {
+            struct mg_node_t* const head = mg_fifo_dequeue(chain);
+            pool->release(mg_fifo_entry(head, struct mg_message_t, link));
+        }
+    } else {
+        mg_queue_push_chain(&pool->queue, chain);
+    }
 }
 
 static inline unsigned _mg_diff_msb(uint32_t x, uint32_t y) {
     assert(x != y);
-    const unsigned width = sizeof(uint32_t) * CHAR_BIT;
-    const unsigned msb = width - mg_port_clz(x ^ y) - 1;
+    const unsigned msb = _mg_msb(x ^ y);
     return (msb < MG_TIMERQ_MAX) ? msb : MG_TIMERQ_MAX - 1;
 }
 
-static inline void mg_context_tick(void) {
+#ifdef MG_WATCHDOG_TICKS
+/*
+ * Called under the context lock. Only the call of each priority and the 
+ * oldest actor in each runqueue are checked, so the cost does not depend on 
+ * number of actors. Preempted calls are reported as well since their age
+ * includes time of the preempting ones.
+ */
+static inline void _mg_watchdog_check(unsigned cpu, struct mg_cpu_context_t* context) {
+    (void) cpu; /* The alarm hook may ignore it. */
+
+    for (unsigned prio = 0; prio < MG_PRIO_MAX; ++prio) {
+        struct mg_watchdog_t* const wd = &context->watchdog[prio];
+        struct mg_actor_t* const running = wd->running;
+
+        if (running && !wd->stalled && 
+            (context->ticks - wd->started >= MG_WATCHDOG_TICKS)) {
+            wd->stalled = true;
+            ++wd->stalls;
+            MG_WATCHDOG_ALARM(running, cpu, true);
+        }
+
+        struct mg_fifo_t* runq = &context->runq[prio];
+#if MG_CPU_MAX > 1
+        if (mg_fifo_empty(runq)) {
+            runq = &context->shared[prio];
+        }
+#endif
+        if (mg_fifo_empty(runq) || wd->starved) {
+            continue;
+        }
+
+        struct mg_actor_t* const head = 
+            mg_fifo_entry(runq->dummy.next, struct mg_actor_t, link);
+
+        if (context->ticks - head->queued >= MG_WATCHDOG_TICKS) {
+            wd->starved = true;
+            ++wd->starvations;
+            MG_WATCHDOG_ALARM(head, cpu, false);
+        }
+    }
+}
+
+static inline void _mg_watchdog_take(struct mg_cpu_context_t* context, unsigned prio) {
+    --context->watchdog[prio].depth;
+    context->watchdog[prio].starved = false;
+}
+
+/*
+ * Actor call keeps running the actor while messages are available, so the
+ * stall timer is restarted for each message.
+ */
+static inline void _mg_watchdog_restart(struct mg_actor_t* actor) {
     struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(mg_cpu_this());
+    struct mg_watchdog_t* const wd = &context->watchdog[actor->prio];
+
+    if (wd->running == actor) {
+        wd->started = context->ticks;
+        wd->stalled = false;
+    }
+}
+#else
+#define _mg_watchdog_check(cpu, context)
+#define _mg_watchdog_take(context, prio)
+#define _mg_watchdog_restart(actor)
+#endif
+
+static inline void mg_context_tick(void) {
+    const unsigned cpu = mg_cpu_this();
+    struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(cpu);
     mg_smp_protect_acquire(&context->lock);
     const uint32_t oldticks = context->ticks++;
+    _mg_watchdog_check(cpu, context);
     const unsigned i = _mg_diff_msb(oldticks, context->ticks);
     struct mg_node_t* const last = mg_fifo_last(&context->timerq[i]);
 
@@ -284,6 +1602,7 @@ static inline void mg_context_tick(void) {
         if (actor->timeout == context->ticks) {
             actor->timeout = 0;
             actor_to_wake = actor;
+            MG_TRACE_TIMER_EXPIRE(actor);
         } else {
             const unsigned j = _mg_diff_msb(actor->timeout, context->ticks);
             mg_fifo_enqueue(&context->timerq[j], &actor->link);
@@ -307,6 +1626,7 @@ static inline void mg_context_tick(void) {
 
 static inline void _mg_actor_timeout(struct mg_actor_t* actor) {
     assert((actor->timeout != 0) && (actor->timeout < INT32_MAX));
+    MG_TRACE_TIMER_ARM(actor, actor->timeout);
     struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(mg_cpu_this());
     mg_smp_protect_acquire(&context->lock);
     actor->timeout += context->ticks;
@@ -315,9 +1635,83 @@ static inline void _mg_actor_timeout(struct mg_actor_t* actor) {
     mg_smp_protect_release(&context->lock);
 }
 
+#ifdef MG_ACTOR_STATS
+/*
+ * Calls of actors nest as interrupts do, so each call saves the time of the
+ * enclosing one spent in nested calls and reports its own total time to it.
+ * The time of nested calls is subtracted from the actor's own time and 
+ * accounted as preemption.
+ */
+static inline uint32_t _mg_actor_stats_begin(
+    struct mg_cpu_context_t* context, 
+    uint32_t* start
+) {
+    _mg_irq_enter();
+    const uint32_t outer = context->nested;
+    context->nested = 0;
+    *start = mg_port_cycles();
+    _mg_irq_leave();
+    return outer;
+}
+
+static inline void _mg_actor_stats_end(
+    struct mg_cpu_context_t* context, 
+    struct mg_actor_t* actor,
+    struct mg_message_t* msg,
+    uint32_t outer,
+    uint32_t start
+) {
+    _mg_irq_enter();
+    const uint32_t elapsed = mg_port_cycles() - start;
+    const uint32_t nested = context->nested;
+    context->nested = outer + elapsed;
+    _mg_irq_leave();
+    const uint32_t own = elapsed - nested;
+    struct mg_actor_stats_t* const stats = &actor->stats;
+    stats->messages += (msg != 0);
+    stats->cycles += own;
+    stats->preempted += nested;
+
+    if (own > stats->max_cycles) {
+        stats->max_cycles = own;
+    }
+}
+#endif
+
+static inline void _mg_actor_yield(struct mg_actor_t* actor) {
+    const unsigned vect = actor->vect;
+    const unsigned cpu = _mg_actor_insert(actor);
+    MG_TRACE_ACTOR_ACTIVATE(actor, cpu, vect);
+
+    if (cpu != mg_cpu_this()) {
+        pic_interrupt_request(cpu, vect);
+    }
+}
+
+/*
+ * Once the actor is subscribed to a queue it may be activated by another CPU,
+ * so the mailbox is never written after unsuccessful pop. If the actor was 
+ * migrated during the call it continues on the new CPU. The same is true for
+ * a message which requires another vector.
+ */
 static inline void mg_actor_call(struct mg_actor_t* actor) {
-    do {
+#ifdef MG_ACTOR_STATS
+    struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(mg_cpu_this());
+    ++actor->stats.activations;
+#endif
+    for (;;) {
+        MG_TRACE_ACTOR_START(actor, actor->mailbox);
+        _mg_watchdog_restart(actor);
+#ifdef MG_ACTOR_STATS
+        struct mg_message_t* const msg_in = actor->mailbox;
+        uint32_t start;
+        const uint32_t outer = _mg_actor_stats_begin(context, &start);
+#endif
         struct mg_queue_t* const q = actor->func(actor, actor->mailbox);
+#ifdef MG_ACTOR_STATS
+        _mg_actor_stats_end(context, actor, msg_in, outer, start);
+#endif
+        MG_TRACE_ACTOR_STOP(actor, q);
         assert(q != 0);
 
         if (q == MG_ACTOR_SUSPEND) {
@@ -326,14 +1720,34 @@ static inline void mg_actor_call(struct mg_actor_t* actor) {
             if (actor->timeout != 0) {
                 _mg_actor_timeout(actor);    
             } else {                    
-                _mg_actor_insert(actor);
+                _mg_actor_yield(actor);
             }
 
             break;
         }
 
-        actor->mailbox = mg_queue_pop(q, actor);
-    } while (actor->mailbox != 0);
+#ifdef MG_QUEUE_BOUNDED
+        if (q == MG_ACTOR_PUSH) {
+            if (!_mg_queue_push_or_park(actor)) {
+                break;
+            }
+        } else
+#endif
+        {
+            struct mg_message_t* const msg = mg_queue_pop(q, actor);
+
+            if (msg == 0) {
+                break;
+            }
+
+            actor->mailbox = msg;
+        }
+
+        if (_mg_actor_retarget(actor, actor->mailbox) || (actor->cpu != mg_cpu_this())) {
+            _mg_actor_activate(actor);
+            break;
+        }
+    }
 }
 
 static inline void mg_actor_init(
@@ -347,8 +1761,24 @@ static inline void mg_actor_init(
     actor->func = func;
     actor->vect = vect;
     actor->cpu = mg_cpu_this();
+    actor->flags = 0;
+#ifdef MG_MESSAGE_PRIO
+    actor->vects = 0;
+    actor->vect_count = 0;
+#endif
     actor->timeout = 0;
     actor->mailbox = 0;
+#ifdef MG_QUEUE_BOUNDED
+    actor->target = 0;
+#endif
+#ifdef MG_ACTOR_STATS
+    actor->stats = (struct mg_actor_stats_t) { 0 };
+#endif
+#ifdef MG_REGISTRY
+    actor->name = 0;
+    actor->waiting = 0;
+    _mg_registry_add(&g_mg_context.registry.actors, &actor->registry);
+#endif
 
     if (q) {
         struct mg_message_t* msg = mg_queue_pop(q, actor);
@@ -359,6 +1789,33 @@ static inline void mg_actor_init(
     }
 }
 
+static inline void mg_actor_migrate(struct mg_actor_t* actor, unsigned cpu) {
+    assert(cpu < MG_CPU_MAX);
+    actor->cpu = cpu;
+}
+
+#ifdef MG_MESSAGE_PRIO
+/*
+ * Message with priority p activates the actor at vects[p], the last vector 
+ * is used for priorities above count. Must be called before any message is
+ * sent to the actor, the array must remain valid while the actor exists.
+ */
+static inline void mg_actor_bind(
+    struct mg_actor_t* actor, 
+    const unsigned* vects, 
+    unsigned count
+) {
+    assert(count != 0);
+
+    for (unsigned i = 0; i < count; ++i) {
+        assert(pic_vect2prio(vects[i]) < MG_PRIO_MAX);
+    }
+
+    actor->vects = vects;
+    actor->vect_count = count;
+}
+#endif
+
 static inline struct mg_queue_t* mg_sleep_for(
     uint32_t delay, 
     struct mg_actor_t* self
@@ -371,27 +1828,168 @@ static inline struct mg_actor_t* _mg_context_pop_head(unsigned vect, bool* last)
     struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(mg_cpu_this());
     const unsigned prio = pic_vect2prio(vect);
     assert(prio < MG_PRIO_MAX);
-    struct mg_fifo_t* const runq = &context->runq[prio];
+    struct mg_fifo_t* runq = &context->runq[prio];
     struct mg_actor_t* actor = 0;
     mg_smp_protect_acquire(&context->lock);
-
+#if MG_CPU_MAX > 1
+    if (mg_fifo_empty(runq)) {
+        runq = &context->shared[prio];
+    }
+#endif
     if (!mg_fifo_empty(runq)) {
         struct mg_node_t* const head = mg_fifo_dequeue(runq);
         actor = mg_fifo_entry(head, struct mg_actor_t, link);
         *last = mg_fifo_empty(runq);
+        _mg_watchdog_take(context, prio);
+#if MG_CPU_MAX > 1
+        if (runq != &context->runq[prio]) {
+            atomic_fetch_sub_explicit(&g_mg_context.migratable[prio], 1, memory_order_relaxed);
+        }
+#endif
     }
 
     mg_smp_protect_release(&context->lock);
     return actor;
 }
 
+#if MG_CPU_MAX > 1
+/*
+ * Migratable actors are taken from other CPUs once local runqueue of the 
+ * same priority is drained. Stolen actor is rebound to this CPU, so all its
+ * subsequent activations, including timeouts, happen here. The global count
+ * lets idle CPUs skip locking every victim when nothing may be stolen. It is
+ * incremented before the idle CPU is kicked, so the kicked CPU sees it.
+ */
+static inline struct mg_actor_t* _mg_context_steal(unsigned prio) {
+    const unsigned this_cpu = mg_cpu_this();
+
+    if (atomic_load_explicit(&g_mg_context.migratable[prio], memory_order_relaxed) == 0) {
+        return 0;
+    }
+
+    for (unsigned i = 1; i < MG_CPU_MAX; ++i) {
+        struct mg_cpu_context_t* const victim = 
+            MG_CPU_CONTEXT((this_cpu + i) % MG_CPU_MAX);
+        struct mg_actor_t* actor = 0;
+        mg_smp_protect_acquire(&victim->lock);
+
+        if (!mg_fifo_empty(&victim->shared[prio])) {
+            struct mg_node_t* const head = mg_fifo_dequeue(&victim->shared[prio]);
+            actor = mg_fifo_entry(head, struct mg_actor_t, link);
+            actor->cpu = this_cpu;
+            _mg_watchdog_take(victim, prio);
+            atomic_fetch_sub_explicit(&g_mg_context.migratable[prio], 1, memory_order_relaxed);
+        }
+
+        mg_smp_protect_release(&victim->lock);
+
+        if (actor) {
+            return actor;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+#ifdef MG_HANDOFF
+static inline struct mg_actor_t* _mg_context_take_deferred(
+    struct mg_cpu_context_t* context, 
+    unsigned prio
+) {
+    struct mg_actor_t* const actor = context->deferred[prio];
+
+    if (actor) {
+        context->deferred[prio] = 0;
+    }
+
+    return actor;
+}
+#endif
+
 static inline void mg_context_schedule(unsigned vect) {
+    struct mg_cpu_context_t* const context = MG_CPU_CONTEXT(mg_cpu_this());
+    const unsigned prio = pic_vect2prio(vect);
+    assert(prio < MG_PRIO_MAX);
     struct mg_actor_t* actor = 0;
+    (void) context;
+#ifdef MG_HANDOFF
+    unsigned handoffs = 0;
+#endif
+#ifdef _MG_CONTEXT_ACTIVE
+    const unsigned mask = 1U << prio;
+    _mg_irq_enter();
+    context->active |= mask;
+    _mg_irq_leave();
+#endif
+
+    /*
+     * Deferred actor is preferred unless it was taken MG_HANDOFF_BURST times
+     * in a row, so actors handing off to each other can't starve the others 
+     * queued at the same priority.
+     */
+    for (;;) {
+        actor = 0;
+#ifdef MG_HANDOFF
+        if (handoffs < MG_HANDOFF_BURST) {
+            actor = _mg_context_take_deferred(context, prio);
+        }
+
+        handoffs = actor ? (handoffs + 1) : 0;
+#endif
+        if (!actor) {
+            actor = _mg_context_pop_head(vect, &(bool) { false });
+        }
+#if MG_CPU_MAX > 1
+        if (!actor) {
+            actor = _mg_context_steal(prio);
+        }
+#endif
+
+        if (!actor) {
+#ifdef _MG_CONTEXT_ACTIVE
+            _mg_irq_enter();
+#ifdef MG_HANDOFF
+            actor = _mg_context_take_deferred(context, prio);
+#endif
+            if (!actor) {
+                context->active &= ~mask;
+            }
 
-    while ((actor = _mg_context_pop_head(vect, &(bool) { false }))) {
+            _mg_irq_leave();
+#endif
+            if (!actor) {
+                break;
+            }
+        }
+#ifdef MG_LATENCY_STATS
+        const uint32_t latency = mg_port_cycles() - actor->activated;
+        ++context->latency[prio][_mg_msb(latency | 1)];
+#endif
+#ifdef MG_WATCHDOG_TICKS
+        struct mg_watchdog_t* const wd = &context->watchdog[prio];
+        wd->started = context->ticks;
+        wd->stalled = false;
+        wd->running = actor;
         mg_actor_call(actor);
+        wd->running = 0;
+#else
+        mg_actor_call(actor);
+#endif
     }
 }
 
+#ifdef MG_LATENCY_STATS
+/*
+ * Bucket i counts activations which waited for [2^i, 2^(i+1)) cycles before
+ * the actor was called, bucket 0 also includes zero latency. Counters are 
+ * updated only by the owner CPU without locks.
+ */
+static inline const uint32_t* mg_latency_histogram(unsigned cpu, unsigned prio) {
+    assert((cpu < MG_CPU_MAX) && (prio < MG_PRIO_MAX));
+    return MG_CPU_CONTEXT(cpu)->latency[prio];
+}
+#endif
+
 #endif
 
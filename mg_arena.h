@@ -0,0 +1,307 @@
+/**
+  * @file  mg_arena.h
+  * @brief Variable-size message allocator with constant time operations.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_ARENA_H
+#define MG_ARENA_H
+
+#include "magnesium.h"
+
+/*
+ * Two-level segregated fit allocator. Free blocks are kept in lists indexed
+ * by the most significant bit of their size and MG_ARENA_SL_LOG2 next bits,
+ * suitable list is found with two bitmap lookups, so both allocation and
+ * free take constant time regardless of arena state.
+ */
+#ifndef MG_ARENA_SL_LOG2
+#define MG_ARENA_SL_LOG2 3
+#endif
+
+#ifndef MG_ARENA_SIZE_LOG2
+#define MG_ARENA_SIZE_LOG2 16 /* Arena may not exceed 2^N bytes. */
+#endif
+
+#if MG_ARENA_SIZE_LOG2 > 31
+#error Arena size is limited to 2^31 bytes.
+#endif
+
+#define MG_ARENA_ALIGN_LOG2 ((sizeof(void*) > 4) ? 3 : 2)
+#define MG_ARENA_ALIGN (1U << MG_ARENA_ALIGN_LOG2)
+#define MG_ARENA_SL_COUNT (1U << MG_ARENA_SL_LOG2)
+#define MG_ARENA_FL_SHIFT (MG_ARENA_SL_LOG2 + MG_ARENA_ALIGN_LOG2)
+#define MG_ARENA_FL_COUNT (MG_ARENA_SIZE_LOG2 - MG_ARENA_FL_SHIFT + 1)
+#define MG_ARENA_FREE 1U
+
+struct mg_arena_block_t {
+    struct mg_arena_block_t* prev_phys;
+    size_t size; /* Including header, the lowest bit is set for free blocks. */
+    struct mg_arena_block_t* next_free; /* Free blocks only, used by message. */
+    struct mg_arena_block_t* prev_free;
+};
+
+#define MG_ARENA_HEADER offsetof(struct mg_arena_block_t, next_free)
+#define MG_ARENA_MIN_BLOCK sizeof(struct mg_arena_block_t)
+
+struct mg_arena_t {
+    struct mg_message_pool_t pool; /* Must be the first member. */
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[MG_ARENA_FL_COUNT];
+    struct mg_arena_block_t* free[MG_ARENA_FL_COUNT][MG_ARENA_SL_COUNT];
+};
+
+static inline size_t _mg_arena_size(struct mg_arena_block_t* block) {
+    return block->size & ~(size_t) MG_ARENA_FREE;
+}
+
+static inline struct mg_arena_block_t* _mg_arena_next(struct mg_arena_block_t* block) {
+    return (struct mg_arena_block_t*)((unsigned char*) block + _mg_arena_size(block));
+}
+
+static inline void _mg_arena_mapping(size_t size, unsigned* fl, unsigned* sl) {
+    if (size < (1U << MG_ARENA_FL_SHIFT)) {
+        *fl = 0;
+        *sl = (unsigned)(size >> MG_ARENA_ALIGN_LOG2);
+    } else {
+        const unsigned msb = _mg_msb((uint32_t) size);
+        *sl = (unsigned)(size >> (msb - MG_ARENA_SL_LOG2)) ^ MG_ARENA_SL_COUNT;
+        *fl = msb - MG_ARENA_FL_SHIFT + 1;
+    }
+}
+
+static inline void _mg_arena_insert(
+    struct mg_arena_t* arena,
+    struct mg_arena_block_t* block
+) {
+    unsigned fl, sl;
+    _mg_arena_mapping(_mg_arena_size(block), &fl, &sl);
+    struct mg_arena_block_t* const head = arena->free[fl][sl];
+    block->next_free = head;
+    block->prev_free = 0;
+
+    if (head) {
+        head->prev_free = block;
+    }
+
+    arena->free[fl][sl] = block;
+    arena->fl_bitmap |= 1U << fl;
+    arena->sl_bitmap[fl] |= 1U << sl;
+}
+
+static inline void _mg_arena_remove(
+    struct mg_arena_t* arena,
+    struct mg_arena_block_t* block
+) {
+    struct mg_arena_block_t* const next = block->next_free;
+    struct mg_arena_block_t* const prev = block->prev_free;
+
+    if (next) {
+        next->prev_free = prev;
+    }
+
+    if (prev) {
+        prev->next_free = next;
+    } else {
+        unsigned fl, sl;
+        _mg_arena_mapping(_mg_arena_size(block), &fl, &sl);
+        arena->free[fl][sl] = next;
+
+        if (!next) {
+            arena->sl_bitmap[fl] &= ~(1U << sl);
+
+            if (!arena->sl_bitmap[fl]) {
+                arena->fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+}
+
+/*
+ * Requested size is rounded up to the next list boundary, so any block from
+ * the found list is large enough.
+ */
+static inline struct mg_arena_block_t* _mg_arena_find(
+    struct mg_arena_t* arena,
+    size_t size
+) {
+    if (size >= (1U << MG_ARENA_FL_SHIFT)) {
+        size += (1U << (_mg_msb((uint32_t) size) - MG_ARENA_SL_LOG2)) - 1;
+    }
+
+    unsigned fl, sl;
+    _mg_arena_mapping(size, &fl, &sl);
+
+    if (fl >= MG_ARENA_FL_COUNT) {
+        return 0;
+    }
+
+    uint32_t sl_map = arena->sl_bitmap[fl] & (~0U << sl);
+
+    if (!sl_map) {
+        const uint32_t fl_map = arena->fl_bitmap & (~0U << (fl + 1));
+
+        if (!fl_map) {
+            return 0;
+        }
+
+        fl = _mg_lsb(fl_map);
+        sl_map = arena->sl_bitmap[fl];
+    }
+
+    return arena->free[fl][_mg_lsb(sl_map)];
+}
+
+static inline void _mg_arena_split(
+    struct mg_arena_t* arena,
+    struct mg_arena_block_t* block,
+    size_t size
+) {
+    const size_t total = _mg_arena_size(block);
+
+    if (total - size >= MG_ARENA_MIN_BLOCK) {
+        struct mg_arena_block_t* const rest =
+            (struct mg_arena_block_t*)((unsigned char*) block + size);
+        rest->prev_phys = block;
+        rest->size = (total - size) | MG_ARENA_FREE;
+        _mg_arena_next(rest)->prev_phys = rest;
+        block->size = size;
+        _mg_arena_insert(arena, rest);
+    } else {
+        block->size = total;
+    }
+}
+
+/*
+ * Freed block is merged with its free neighbours. Actors waiting for memory
+ * are activated with empty message one at a time and should retry allocation.
+ * The notification is also latched, so an actor which failed to allocate
+ * before this free but subscribes after it is activated at once, even if
+ * another actor was already waiting and took the wakeup.
+ */
+static inline void _mg_arena_release(struct mg_message_t* msg) {
+    struct mg_arena_t* const arena = (struct mg_arena_t*) msg->parent;
+    struct mg_arena_block_t* block =
+        (struct mg_arena_block_t*)((unsigned char*) msg - MG_ARENA_HEADER);
+    _mg_message_stamp(msg);
+    mg_smp_protect_acquire(&arena->pool.queue.lock);
+    _mg_queue_retired(&arena->pool.queue, msg); /* Before the header is reused. */
+    block->size |= MG_ARENA_FREE;
+    struct mg_arena_block_t* const next = _mg_arena_next(block);
+
+    if (next->size & MG_ARENA_FREE) {
+        _mg_arena_remove(arena, next);
+        block->size += _mg_arena_size(next);
+        _mg_arena_next(block)->prev_phys = block;
+    }
+
+    struct mg_arena_block_t* const prev = block->prev_phys;
+
+    if (prev && (prev->size & MG_ARENA_FREE)) {
+        _mg_arena_remove(arena, prev);
+        prev->size += _mg_arena_size(block);
+        _mg_arena_next(prev)->prev_phys = prev;
+        block = prev;
+    }
+
+    _mg_arena_insert(arena, block);
+    const bool waiting = (arena->pool.queue.length < 0);
+    arena->pool.queue.flags |= _MG_QUEUE_PENDING;
+    mg_smp_protect_release(&arena->pool.queue.lock);
+
+    if (waiting) {
+        mg_queue_notify(&arena->pool.queue);
+    }
+}
+
+/*
+ * The last header-sized chunk of memory is reserved for zero-sized sentinel
+ * block, so the last real block always has a neighbour.
+ */
+static inline void mg_arena_init(struct mg_arena_t* arena, void* mem, size_t len) {
+    _mg_queue_init(&arena->pool.queue);
+    arena->pool.queue.flags = MG_QUEUE_LATCH;
+    arena->pool.array = 0;
+    arena->pool.total_length = 0;
+    arena->pool.block_sz = 0;
+    arena->pool.offset = 0;
+    arena->pool.array_space_available = false;
+    arena->pool.release = _mg_arena_release;
+#ifdef MG_QUEUE_STATS
+    arena->pool.stats = (struct mg_pool_stats_t) { 0 };
+#endif
+#ifdef MG_MESSAGE_STATS
+    for (unsigned i = 0; i < MG_RESIDENCY_BUCKETS; ++i) {
+        arena->pool.lifetime[i] = 0;
+    }
+
+    arena->pool.queue.lifetime = arena->pool.lifetime;
+#endif
+    arena->fl_bitmap = 0;
+
+    for (unsigned i = 0; i < MG_ARENA_FL_COUNT; ++i) {
+        arena->sl_bitmap[i] = 0;
+
+        for (unsigned j = 0; j < MG_ARENA_SL_COUNT; ++j) {
+            arena->free[i][j] = 0;
+        }
+    }
+
+    const uintptr_t mask = MG_ARENA_ALIGN - 1;
+    const uintptr_t start = ((uintptr_t) mem + mask) & ~mask;
+    assert(len > (start - (uintptr_t) mem));
+    const size_t size =
+        ((len - (start - (uintptr_t) mem)) & ~(size_t) mask) - MG_ARENA_HEADER;
+    assert((size >= MG_ARENA_MIN_BLOCK) && (size < (1UL << MG_ARENA_SIZE_LOG2)));
+    struct mg_arena_block_t* const block = (struct mg_arena_block_t*) start;
+    block->prev_phys = 0;
+    block->size = size | MG_ARENA_FREE;
+    struct mg_arena_block_t* const sentinel = _mg_arena_next(block);
+    sentinel->prev_phys = block;
+    sentinel->size = 0;
+    _mg_arena_insert(arena, block);
+}
+
+/*
+ * Size includes message header. If there is no suitable block NULL is
+ * returned and the arena may be typecasted to a queue to wait for memory.
+ */
+static inline void* mg_arena_alloc(struct mg_arena_t* arena, size_t size) {
+    assert(size >= sizeof(struct mg_message_t));
+    const size_t mask = MG_ARENA_ALIGN - 1;
+    size_t need = (size + MG_ARENA_HEADER + mask) & ~mask;
+
+    if (need < MG_ARENA_MIN_BLOCK) {
+        need = MG_ARENA_MIN_BLOCK;
+    }
+
+    if (need >= (1UL << MG_ARENA_SIZE_LOG2)) {
+        return 0;
+    }
+
+    struct mg_message_t* msg = 0;
+    mg_smp_protect_acquire(&arena->pool.queue.lock);
+    arena->pool.queue.flags &= ~_MG_QUEUE_PENDING; /* Frees so far are seen. */
+    struct mg_arena_block_t* const block = _mg_arena_find(arena, need);
+
+    if (block) {
+        _mg_arena_remove(arena, block);
+        _mg_arena_split(arena, block, need);
+        msg = (struct mg_message_t*)((unsigned char*) block + MG_ARENA_HEADER);
+        msg->parent = &arena->pool;
+        _mg_message_reset_prio(msg);
+    }
+
+    mg_smp_protect_release(&arena->pool.queue.lock);
+
+    if (msg) {
+        _mg_message_born(msg);
+        MG_TRACE_POOL_ALLOC(&arena->pool, msg);
+    } else {
+        MG_TRACE_POOL_EMPTY(&arena->pool);
+    }
+
+    return msg;
+}
+
+#endif
@@ -0,0 +1,130 @@
+/**
+  * @file  mg_coalesce.h
+  * @brief Message queue which keeps at most one pending message per key.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_COALESCE_H
+#define MG_COALESCE_H
+
+#include "magnesium.h"
+
+#ifndef MG_QUEUE_HOOKS
+#error mg_coalesce.h requires MG_QUEUE_HOOKS to be defined.
+#endif
+
+#ifndef MG_COALESCE_BUCKETS_LOG2
+#define MG_COALESCE_BUCKETS_LOG2 4
+#endif
+
+#define MG_COALESCE_BUCKETS (1U << MG_COALESCE_BUCKETS_LOG2)
+
+struct mg_keyed_t {
+    struct mg_message_t header; /* Must be the first member. */
+    uintptr_t key;
+    struct mg_keyed_t* prev; /* Delivery order. */
+    struct mg_keyed_t* next;
+    struct mg_keyed_t* chain; /* Other pending messages in the same bucket. */
+};
+
+struct mg_coalesce_queue_t {
+    struct mg_queue_t queue; /* Must be the first member. */
+    bool replace;
+    struct mg_keyed_t* head;
+    struct mg_keyed_t* tail;
+    struct mg_keyed_t* buckets[MG_COALESCE_BUCKETS];
+};
+
+/*
+ * Keys colliding in the same bucket are chained, so lookup time is bounded 
+ * only by the number of pending messages in that bucket.
+ */
+static inline struct mg_keyed_t** _mg_coalesce_bucket(
+    struct mg_coalesce_queue_t* cq,
+    uintptr_t key
+) {
+    const uint32_t hash = (uint32_t) key * 2654435769U;
+    return &cq->buckets[hash >> (32 - MG_COALESCE_BUCKETS_LOG2)];
+}
+
+/*
+ * Pending message with the same key is either replaced by the new one, which
+ * takes its place in delivery order, or kept while the new one is dropped.
+ * The displaced message is returned to the caller and freed by the kernel.
+ * Replacement works in a full bounded queue as well.
+ */
+static inline struct mg_message_t* _mg_coalesce_put(
+    struct mg_queue_t* q,
+    struct mg_message_t* msg
+) {
+    struct mg_coalesce_queue_t* const cq = (struct mg_coalesce_queue_t*) q;
+    struct mg_keyed_t* const item = (struct mg_keyed_t*) msg;
+    struct mg_keyed_t** p = _mg_coalesce_bucket(cq, item->key);
+
+    while ((*p != 0) && ((*p)->key != item->key)) {
+        p = &(*p)->chain;
+    }
+
+    struct mg_keyed_t* const old = *p;
+
+    if (old == 0) {
+        if (_mg_queue_refuses(q)) {
+            return msg;
+        }
+
+        item->chain = 0;
+        *p = item;
+        item->prev = cq->tail;
+        item->next = 0;
+        *(cq->tail ? &cq->tail->next : &cq->head) = item;
+        cq->tail = item;
+        return 0;
+    }
+
+    if (!cq->replace) {
+        return msg;
+    }
+
+    item->chain = old->chain;
+    *p = item;
+    item->prev = old->prev;
+    item->next = old->next;
+    *(old->prev ? &old->prev->next : &cq->head) = item;
+    *(old->next ? &old->next->prev : &cq->tail) = item;
+    return &old->header;
+}
+
+static inline struct mg_message_t* _mg_coalesce_get(struct mg_queue_t* q) {
+    struct mg_coalesce_queue_t* const cq = (struct mg_coalesce_queue_t*) q;
+    struct mg_keyed_t* const item = cq->head;
+    assert(item != 0);
+    cq->head = item->next;
+    *(item->next ? &item->next->prev : &cq->tail) = 0;
+    struct mg_keyed_t** p = _mg_coalesce_bucket(cq, item->key);
+
+    while (*p != item) {
+        p = &(*p)->chain;
+    }
+
+    *p = item->chain;
+    return &item->header;
+}
+
+/*
+ * All messages sent to the queue must have mg_keyed_t header with the key
+ * set. The queue is used via typecast to mg_queue_t.
+ */
+static inline void mg_coalesce_queue_init(struct mg_coalesce_queue_t* cq, bool replace) {
+    mg_queue_init(&cq->queue);
+    cq->queue.put = _mg_coalesce_put;
+    cq->queue.get = _mg_coalesce_get;
+    cq->replace = replace;
+    cq->head = 0;
+    cq->tail = 0;
+
+    for (unsigned i = 0; i < MG_COALESCE_BUCKETS; ++i) {
+        cq->buckets[i] = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,70 @@
+/**
+  * @file  mg_pool_set.h
+  * @brief Size-class message pools with single allocation entry point.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_POOL_SET_H
+#define MG_POOL_SET_H
+
+#include "magnesium.h"
+
+#ifndef MG_POOL_SET_MAX
+#define MG_POOL_SET_MAX 4
+#endif
+
+struct mg_pool_set_t {
+    struct mg_message_pool_t* classes[MG_POOL_SET_MAX];
+    unsigned count;
+};
+
+/*
+ * Pools must be initialized and sorted by block size in ascending order.
+ */
+static inline void mg_pool_set_init(
+    struct mg_pool_set_t* set,
+    struct mg_message_pool_t* const* pools,
+    unsigned count
+) {
+    assert((count != 0) && (count <= MG_POOL_SET_MAX));
+    set->count = count;
+
+    for (unsigned i = 0; i < count; ++i) {
+        assert((i == 0) || (pools[i - 1]->block_sz < pools[i]->block_sz));
+        set->classes[i] = pools[i];
+    }
+}
+
+static inline struct mg_message_pool_t* mg_pool_set_class(
+    struct mg_pool_set_t* set,
+    size_t size
+) {
+    for (unsigned i = 0; i < set->count; ++i) {
+        if (set->classes[i]->block_sz >= size) {
+            return set->classes[i];
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Message is allocated from the smallest class fitting the requested size.
+ * If that class is exhausted NULL is returned and the caller may wait on the 
+ * queue returned by mg_pool_set_queue just like on a single pool. Sizes above
+ * the largest class get NULL from both functions, such requests never succeed.
+ */
+static inline void* mg_message_alloc_sized(struct mg_pool_set_t* set, size_t size) {
+    struct mg_message_pool_t* const pool = mg_pool_set_class(set, size);
+    return pool ? mg_message_alloc(pool) : 0;
+}
+
+static inline struct mg_queue_t* mg_pool_set_queue(
+    struct mg_pool_set_t* set, 
+    size_t size
+) {
+    struct mg_message_pool_t* const pool = mg_pool_set_class(set, size);
+    return pool ? &pool->queue : 0;
+}
+
+#endif
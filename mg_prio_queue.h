@@ -0,0 +1,97 @@
+/**
+  * @file  mg_prio_queue.h
+  * @brief Message queue ordered by message priority.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_PRIO_QUEUE_H
+#define MG_PRIO_QUEUE_H
+
+#include "magnesium.h"
+
+#if !defined(MG_MESSAGE_PRIO) || !defined(MG_QUEUE_HOOKS)
+#error mg_prio_queue.h requires MG_MESSAGE_PRIO and MG_QUEUE_HOOKS to be defined.
+#endif
+
+#ifndef MG_PRIO_QUEUE_LEVELS
+#define MG_PRIO_QUEUE_LEVELS 8
+#endif
+
+#if MG_PRIO_QUEUE_LEVELS > 32
+#error Priority queue supports up to 32 levels.
+#endif
+
+/*
+ * Each priority level has its own fifo, nonempty levels are marked in the
+ * bitmap, so both put and get take constant time. Higher value is more
+ * urgent, messages of the same priority are delivered in FIFO order.
+ */
+struct mg_prio_queue_t {
+    struct mg_queue_t queue; /* Must be the first member. */
+    uint32_t bitmap;
+    struct mg_fifo_t levels[MG_PRIO_QUEUE_LEVELS];
+};
+
+static inline struct mg_message_t* _mg_prio_queue_put(
+    struct mg_queue_t* q,
+    struct mg_message_t* msg
+) {
+    struct mg_prio_queue_t* const pq = (struct mg_prio_queue_t*) q;
+    assert(msg->prio < MG_PRIO_QUEUE_LEVELS);
+
+    if (_mg_queue_refuses(q)) {
+        return msg;
+    }
+
+    mg_fifo_enqueue(&pq->levels[msg->prio], &msg->link);
+    pq->bitmap |= 1U << msg->prio;
+    return 0;
+}
+
+static inline struct mg_message_t* _mg_prio_queue_get(struct mg_queue_t* q) {
+    struct mg_prio_queue_t* const pq = (struct mg_prio_queue_t*) q;
+    assert(pq->bitmap != 0);
+    const unsigned level = _mg_msb(pq->bitmap);
+    struct mg_node_t* const head = mg_fifo_dequeue(&pq->levels[level]);
+
+    if (mg_fifo_empty(&pq->levels[level])) {
+        pq->bitmap &= ~(1U << level);
+    }
+
+    return mg_fifo_entry(head, struct mg_message_t, link);
+}
+
+/*
+ * Full queue with MG_QUEUE_DROP_OLDEST drops the oldest message of the lowest
+ * priority, which may be the new message itself.
+ */
+static inline struct mg_message_t* _mg_prio_queue_evict(struct mg_queue_t* q) {
+    struct mg_prio_queue_t* const pq = (struct mg_prio_queue_t*) q;
+    assert(pq->bitmap != 0);
+    const unsigned level = _mg_lsb(pq->bitmap);
+    struct mg_node_t* const head = mg_fifo_dequeue(&pq->levels[level]);
+
+    if (mg_fifo_empty(&pq->levels[level])) {
+        pq->bitmap &= ~(1U << level);
+    }
+
+    return mg_fifo_entry(head, struct mg_message_t, link);
+}
+
+/*
+ * The queue is used as usual via typecast to mg_queue_t, set msg->prio
+ * before push.
+ */
+static inline void mg_prio_queue_init(struct mg_prio_queue_t* pq) {
+    mg_queue_init(&pq->queue);
+    pq->queue.put = _mg_prio_queue_put;
+    pq->queue.get = _mg_prio_queue_get;
+    pq->queue.evict = _mg_prio_queue_evict;
+    pq->bitmap = 0;
+
+    for (unsigned i = 0; i < MG_PRIO_QUEUE_LEVELS; ++i) {
+        mg_fifo_init(&pq->levels[i]);
+    }
+}
+
+#endif
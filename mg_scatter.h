@@ -0,0 +1,114 @@
+/**
+  * @file  mg_scatter.h
+  * @brief Scatter/gather of work items across worker actors.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_SCATTER_H
+#define MG_SCATTER_H
+
+#include "magnesium.h"
+
+#ifndef MG_SCATTER_MAX
+#define MG_SCATTER_MAX MG_CPU_MAX
+#endif
+
+struct mg_scatter_t {
+    struct mg_smp_protect_t lock;
+    struct mg_queue_t* workers[MG_SCATTER_MAX];
+    struct mg_fifo_t batch[MG_SCATTER_MAX];
+    unsigned width;
+    unsigned next;
+    unsigned queued;
+    unsigned pending;
+    struct mg_message_t* join;
+    struct mg_queue_t* reply;
+};
+
+struct mg_work_t {
+    struct mg_message_t header; /* Must be the first member. */
+    struct mg_scatter_t* job;
+};
+
+static inline void mg_scatter_init(
+    struct mg_scatter_t* sg,
+    struct mg_queue_t* const* workers,
+    unsigned width
+) {
+    assert((width != 0) && (width <= MG_SCATTER_MAX));
+    mg_smp_protect_init(&sg->lock);
+    sg->width = width;
+    sg->next = 0;
+    sg->queued = 0;
+    sg->pending = 0;
+    sg->join = 0;
+    sg->reply = 0;
+
+    for (unsigned i = 0; i < width; ++i) {
+        sg->workers[i] = workers[i];
+        mg_fifo_init(&sg->batch[i]);
+    }
+}
+
+static inline void mg_scatter_begin(
+    struct mg_scatter_t* sg,
+    struct mg_message_t* join,
+    struct mg_queue_t* reply
+) {
+    assert((sg->pending == 0) && (sg->queued == 0));
+    sg->join = join;
+    sg->reply = reply;
+    sg->next = 0;
+}
+
+/*
+ * Items are distributed among workers in round-robin order. They are kept
+ * locally until commit, so no locks are taken here.
+ */
+static inline void mg_scatter_add(struct mg_scatter_t* sg, struct mg_work_t* item) {
+    item->job = sg;
+    mg_fifo_enqueue(&sg->batch[sg->next], &item->header.link);
+    sg->next = (sg->next + 1) % sg->width;
+    ++sg->queued;
+}
+
+/*
+ * Each worker queue receives its whole batch at once, so every worker is
+ * activated at most once per commit.
+ */
+static inline void mg_scatter_commit(struct mg_scatter_t* sg) {
+    assert(sg->queued != 0);
+    mg_smp_protect_acquire(&sg->lock);
+    sg->pending = sg->queued;
+    mg_smp_protect_release(&sg->lock);
+    sg->queued = 0;
+
+    for (unsigned i = 0; i < sg->width; ++i) {
+        mg_queue_push_chain(sg->workers[i], &sg->batch[i]);
+    }
+}
+
+/*
+ * Called by worker once the item is processed. The item is returned to its
+ * pool and the last one sends join message to the reply queue.
+ */
+static inline void mg_scatter_complete(struct mg_work_t* item) {
+    struct mg_scatter_t* const sg = item->job;
+    struct mg_message_t* join = 0;
+    struct mg_queue_t* reply = 0;
+    mg_message_free(&item->header);
+    mg_smp_protect_acquire(&sg->lock);
+
+    if (--sg->pending == 0) {
+        join = sg->join;
+        reply = sg->reply;
+    }
+
+    mg_smp_protect_release(&sg->lock);
+
+    if (join) {
+        mg_queue_push(reply, join);
+    }
+}
+
+#endif
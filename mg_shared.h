@@ -0,0 +1,100 @@
+/**
+  * @file  mg_shared.h
+  * @brief Reference-counted messages for zero-copy multicast.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_SHARED_H
+#define MG_SHARED_H
+
+#include "magnesium.h"
+
+/*
+ * Shared payload is never sent to queues directly since it has the single 
+ * link. Instead, each receiver gets its own small envelope pointing to the 
+ * payload. The payload is returned to its pool when the last envelope is 
+ * freed.
+ */
+struct mg_shared_t {
+    struct mg_message_t header; /* Must be the first member. */
+    struct mg_smp_protect_t lock;
+    unsigned refs;
+};
+
+struct mg_envelope_t {
+    struct mg_message_t header;
+    struct mg_shared_t* payload;
+};
+
+static inline void mg_shared_put(struct mg_shared_t* payload) {
+    mg_smp_protect_acquire(&payload->lock);
+    assert(payload->refs != 0);
+    const bool last = (--payload->refs == 0);
+    mg_smp_protect_release(&payload->lock);
+
+    if (last) {
+        mg_message_free(&payload->header);
+    }
+}
+
+static inline void _mg_envelope_release(struct mg_message_t* msg) {
+    struct mg_shared_t* const payload = ((struct mg_envelope_t*) msg)->payload;
+    mg_queue_push(&msg->parent->queue, msg);
+    mg_shared_put(payload);
+}
+
+static inline void mg_envelope_pool_init(
+    struct mg_message_pool_t* pool,
+    void* mem,
+    size_t total_len
+) {
+    mg_message_pool_init(pool, mem, total_len, sizeof(struct mg_envelope_t));
+    pool->release = _mg_envelope_release;
+}
+
+static inline struct mg_shared_t* mg_shared_payload(struct mg_message_t* msg) {
+    assert(msg->parent->release == _mg_envelope_release);
+    return ((struct mg_envelope_t*) msg)->payload;
+}
+
+/*
+ * Delivers the payload to all the queues. Ownership of the payload is passed
+ * to receivers on success. If there are not enough envelopes nothing is sent
+ * and false is returned, the caller still owns the payload in this case.
+ */
+static inline bool mg_shared_push(
+    struct mg_message_pool_t* envelopes,
+    struct mg_shared_t* payload,
+    struct mg_queue_t* const* queues,
+    size_t n
+) {
+    struct mg_fifo_t chain;
+    mg_fifo_init(&chain);
+
+    if (mg_message_alloc_n(envelopes, &chain, n) != n) {
+        mg_queue_push_chain(&envelopes->queue, &chain);
+        return false;
+    }
+
+    mg_smp_protect_init(&payload->lock);
+    payload->refs = (unsigned) n;
+
+    for (size_t i = 0; i < n; ++i) {
+        struct mg_node_t* const head = mg_fifo_dequeue(&chain);
+        struct mg_envelope_t* const envelope = 
+            mg_fifo_entry(head, struct mg_envelope_t, header.link);
+        envelope->payload = payload;
+#ifdef MG_MESSAGE_PRIO
+        envelope->header.prio = payload->header.prio;
+#endif
+        mg_queue_push(queues[i], &envelope->header);
+    }
+
+    if (n == 0) {
+        mg_message_free(&payload->header);
+    }
+
+    return true;
+}
+
+#endif
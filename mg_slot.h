@@ -0,0 +1,93 @@
+/**
+  * @file  mg_slot.h
+  * @brief Latest-value mailbox holding at most one message.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_SLOT_H
+#define MG_SLOT_H
+
+#include "magnesium.h"
+
+#if !defined(__STDC_NO_ATOMICS__)
+#   include <stdatomic.h>
+#   if ATOMIC_POINTER_LOCK_FREE == 2
+#       define MG_SLOT_LOCK_FREE 1
+#   endif
+#endif
+
+/*
+ * Each publish replaces the message in the slot and frees the displaced one. 
+ * The consumer is notified only when the slot becomes full: the token message
+ * embedded into the slot is pushed into its queue. Since the slot is emptied
+ * only by the consumer holding the token, the token is never queued twice.
+ * On platforms without lock-free atomic pointers (e.g. ARMv6-M) the slot is
+ * protected by its own lock.
+ */
+struct mg_slot_t {
+    struct mg_queue_t queue; /* Must be the first member. */
+    struct mg_message_t token;
+#ifdef MG_SLOT_LOCK_FREE
+    _Atomic(struct mg_message_t*) value;
+#else
+    struct mg_smp_protect_t lock;
+    struct mg_message_t* value;
+#endif
+};
+
+static inline struct mg_message_t* _mg_slot_exchange(
+    struct mg_slot_t* slot, 
+    struct mg_message_t* msg
+) {
+#ifdef MG_SLOT_LOCK_FREE
+    return atomic_exchange_explicit(&slot->value, msg, memory_order_acq_rel);
+#else
+    mg_smp_protect_acquire(&slot->lock);
+    struct mg_message_t* const old = slot->value;
+    slot->value = msg;
+    mg_smp_protect_release(&slot->lock);
+    return old;
+#endif
+}
+
+static inline void mg_slot_init(struct mg_slot_t* slot) {
+    mg_queue_init(&slot->queue);
+    slot->token = (struct mg_message_t){ 0 };
+    slot->token.parent = 0;
+#ifdef MG_SLOT_LOCK_FREE
+    atomic_init(&slot->value, 0);
+#else
+    mg_smp_protect_init(&slot->lock);
+    slot->value = 0;
+#endif
+}
+
+/*
+ * Replacing the value is lock-free, the queue is touched only when the slot 
+ * goes from empty to full. Note that the displaced message is returned to its
+ * pool as usual.
+ */
+static inline void mg_slot_publish(struct mg_slot_t* slot, struct mg_message_t* msg) {
+    assert(msg != 0);
+    struct mg_message_t* const old = _mg_slot_exchange(slot, msg);
+
+    if (old) {
+        mg_message_free(old);
+    } else {
+        mg_queue_push(&slot->queue, &slot->token);
+    }
+}
+
+/*
+ * Must be called by the consumer after receiving the token from slot queue.
+ */
+static inline struct mg_message_t* mg_slot_take(
+    struct mg_slot_t* slot, 
+    struct mg_message_t* token
+) {
+    assert(token == &slot->token);
+    (void) token;
+    return _mg_slot_exchange(slot, 0);
+}
+
+#endif
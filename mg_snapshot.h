@@ -0,0 +1,196 @@
+/**
+  * @file  mg_snapshot.h
+  * @brief Fixed-layout snapshot of registered actors, queues and pools.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_SNAPSHOT_H
+#define MG_SNAPSHOT_H
+
+#include <stdatomic.h>
+#include "magnesium.h"
+
+#ifndef MG_REGISTRY
+#error mg_snapshot.h requires MG_REGISTRY to be defined.
+#endif
+
+#ifndef MG_SNAPSHOT_ACTORS
+#define MG_SNAPSHOT_ACTORS 32
+#endif
+
+#ifndef MG_SNAPSHOT_QUEUES
+#define MG_SNAPSHOT_QUEUES 32
+#endif
+
+#ifndef MG_SNAPSHOT_POOLS
+#define MG_SNAPSHOT_POOLS 8
+#endif
+
+#define MG_SNAPSHOT_NAME 16
+#define MG_SNAPSHOT_MAGIC 0x4E53474DU /* "MGSN" in little-endian. */
+
+/*
+ * All fields have fixed size and there is no padding, so the snapshot may be
+ * placed into shared memory or dumped from target and decoded by tools/mgtop
+ * without knowing build options. Pointers are truncated to 32 bits, cycles
+ * are zero unless MG_ACTOR_STATS is defined, capacity is zero unless
+ * MG_QUEUE_BOUNDED is defined.
+ */
+struct mg_snapshot_actor_t {
+    char name[MG_SNAPSHOT_NAME];
+    uint32_t object;
+    uint32_t queue; /* Queue the actor is waiting on. */
+    uint32_t activations;
+    uint32_t cycles;
+    uint16_t vect;
+    uint8_t state;
+    uint8_t cpu;
+};
+
+struct mg_snapshot_queue_t {
+    char name[MG_SNAPSHOT_NAME];
+    uint32_t object;
+    int32_t length; /* Negative length is the number of waiting actors. */
+    int32_t capacity;
+};
+
+struct mg_snapshot_pool_t {
+    char name[MG_SNAPSHOT_NAME];
+    uint32_t object;
+    uint32_t blocks;
+    uint32_t free;
+};
+
+/*
+ * Sequence is odd while the snapshot is being written, the reader retries if
+ * it was odd or changed during the copy.
+ */
+struct mg_snapshot_t {
+    uint32_t magic;
+    _Atomic uint32_t sequence;
+    uint32_t cpu0_ticks; /* Tick counters of other CPUs are not recorded. */
+    uint16_t actor_count;
+    uint16_t actor_max;
+    uint16_t queue_count;
+    uint16_t queue_max;
+    uint16_t pool_count;
+    uint16_t pool_max;
+    struct mg_snapshot_actor_t actors[MG_SNAPSHOT_ACTORS];
+    struct mg_snapshot_queue_t queues[MG_SNAPSHOT_QUEUES];
+    struct mg_snapshot_pool_t pools[MG_SNAPSHOT_POOLS];
+};
+
+_Static_assert(sizeof(struct mg_snapshot_actor_t) == 36, "unexpected padding");
+_Static_assert(sizeof(struct mg_snapshot_queue_t) == 28, "unexpected padding");
+_Static_assert(sizeof(struct mg_snapshot_pool_t) == 28, "unexpected padding");
+
+static inline void _mg_snapshot_name(char* dst, const char* src) {
+    unsigned i = 0;
+
+    for (; src && src[i] && (i < MG_SNAPSHOT_NAME - 1); ++i) {
+        dst[i] = src[i];
+    }
+
+    for (; i < MG_SNAPSHOT_NAME; ++i) {
+        dst[i] = '\0';
+    }
+}
+
+/*
+ * Objects beyond the configured maximums are skipped. Fields of each object
+ * are read without locking, so the snapshot is not atomic across objects.
+ */
+static inline void mg_snapshot_take(struct mg_snapshot_t* snap) {
+    const uint32_t seq = atomic_load_explicit(&snap->sequence, memory_order_relaxed);
+    atomic_store_explicit(&snap->sequence, seq | 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    snap->magic = MG_SNAPSHOT_MAGIC;
+    snap->cpu0_ticks = MG_CPU_CONTEXT(0)->ticks;
+    snap->actor_max = MG_SNAPSHOT_ACTORS;
+    snap->queue_max = MG_SNAPSHOT_QUEUES;
+    snap->pool_max = MG_SNAPSHOT_POOLS;
+    unsigned n = 0;
+
+    for (struct mg_actor_t* actor = mg_registry_next_actor(0);
+        actor && (n < MG_SNAPSHOT_ACTORS);
+        actor = mg_registry_next_actor(actor), ++n) {
+        struct mg_snapshot_actor_t* const rec = &snap->actors[n];
+        _mg_snapshot_name(rec->name, actor->name);
+        rec->object = (uint32_t)(uintptr_t) actor;
+        rec->queue = (uint32_t)(uintptr_t) actor->waiting;
+#ifdef MG_ACTOR_STATS
+        rec->activations = actor->stats.activations;
+        rec->cycles = (uint32_t) actor->stats.cycles;
+#else
+        rec->activations = 0;
+        rec->cycles = 0;
+#endif
+        rec->vect = (uint16_t) actor->vect;
+        rec->state = (uint8_t) mg_actor_state(actor);
+        rec->cpu = (uint8_t) actor->cpu;
+    }
+
+    snap->actor_count = (uint16_t) n;
+    n = 0;
+
+    for (struct mg_queue_t* q = mg_registry_next_queue(0);
+        q && (n < MG_SNAPSHOT_QUEUES);
+        q = mg_registry_next_queue(q), ++n) {
+        struct mg_snapshot_queue_t* const rec = &snap->queues[n];
+        _mg_snapshot_name(rec->name, q->name);
+        rec->object = (uint32_t)(uintptr_t) q;
+        rec->length = q->length;
+#ifdef MG_QUEUE_BOUNDED
+        rec->capacity = q->capacity;
+#else
+        rec->capacity = 0;
+#endif
+    }
+
+    snap->queue_count = (uint16_t) n;
+    n = 0;
+
+    for (struct mg_message_pool_t* pool = mg_registry_next_pool(0);
+        pool && (n < MG_SNAPSHOT_POOLS);
+        pool = mg_registry_next_pool(pool), ++n) {
+        struct mg_snapshot_pool_t* const rec = &snap->pools[n];
+        _mg_snapshot_name(rec->name, pool->name);
+        rec->object = (uint32_t)(uintptr_t) pool;
+        rec->blocks = (uint32_t)(pool->total_length / pool->block_sz);
+        rec->free = (uint32_t) mg_pool_free_count(pool);
+    }
+
+    snap->pool_count = (uint16_t) n;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&snap->sequence, (seq | 1) + 1, memory_order_relaxed);
+}
+
+#ifdef MG_SNAPSHOT_SHM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * Hosted ports only. Creates POSIX shared memory object (e.g. "/mgtop", seen
+ * as /dev/shm/mgtop on Linux) for periodic mg_snapshot_take calls. Returns
+ * NULL on failure.
+ */
+static inline struct mg_snapshot_t* mg_snapshot_shm(const char* name) {
+    const int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+
+    if (fd < 0) {
+        return 0;
+    }
+
+    void* p = MAP_FAILED;
+
+    if (ftruncate(fd, sizeof(struct mg_snapshot_t)) == 0) {
+        p = mmap(0, sizeof(struct mg_snapshot_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+    return (p != MAP_FAILED) ? p : 0;
+}
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+/**
+  * @file  mg_top.h
+  * @brief Top-style text report of per-actor CPU usage.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_TOP_H
+#define MG_TOP_H
+
+#include <stdio.h>
+#include "magnesium.h"
+
+#ifndef MG_ACTOR_STATS
+#error mg_top.h requires MG_ACTOR_STATS to be defined.
+#endif
+
+#ifndef MG_TOP_MAX
+#define MG_TOP_MAX 16
+#endif
+
+struct mg_top_entry_t {
+    const char* name;
+    struct mg_actor_t* actor;
+};
+
+static inline size_t _mg_top_append(size_t len, size_t used, int n) {
+    if ((n < 0) || (used >= len)) {
+        return used;
+    }
+
+    return ((size_t) n < len - used) ? used + (size_t) n : len - 1;
+}
+
+/*
+ * Actors are listed in descending order of CPU time, the share is relative to
+ * the total time of listed actors. Counters are copied without locking, so a
+ * line may be slightly inconsistent if the actor is running on another CPU.
+ * Returns the length of the text, which is truncated to fit the buffer.
+ */
+static inline size_t mg_top_format(
+    char* buf,
+    size_t len,
+    const struct mg_top_entry_t* entries,
+    size_t n
+) {
+    struct mg_actor_stats_t stats[MG_TOP_MAX];
+    unsigned order[MG_TOP_MAX];
+    uint64_t total = 0;
+    assert((n <= MG_TOP_MAX) && (len != 0));
+
+    for (unsigned i = 0; i < n; ++i) {
+        stats[i] = entries[i].actor->stats;
+        total += stats[i].cycles;
+        unsigned j = i;
+
+        for (; (j > 0) && (stats[order[j - 1]].cycles < stats[i].cycles); --j) {
+            order[j] = order[j - 1];
+        }
+
+        order[j] = i;
+    }
+
+    buf[0] = '\0';
+    size_t used = _mg_top_append(len, 0, snprintf(buf, len,
+        "%-16s %8s %8s %12s %6s %10s %12s\n",
+        "ACTOR", "ACT", "MSGS", "CYCLES", "CPU%", "MAX", "PREEMPTED"));
+
+    for (unsigned i = 0; i < n; ++i) {
+        const struct mg_actor_stats_t* const s = &stats[order[i]];
+        const unsigned permille = total ? (unsigned)((s->cycles * 1000) / total) : 0;
+        used = _mg_top_append(len, used, snprintf(buf + used, len - used,
+            "%-16s %8lu %8lu %12llu %4u.%u %10lu %12llu\n",
+            entries[order[i]].name,
+            (unsigned long) s->activations,
+            (unsigned long) s->messages,
+            (unsigned long long) s->cycles,
+            permille / 10, permille % 10,
+            (unsigned long) s->max_cycles,
+            (unsigned long long) s->preempted));
+    }
+
+    return used;
+}
+
+#endif
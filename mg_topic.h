@@ -0,0 +1,126 @@
+/**
+  * @file  mg_topic.h
+  * @brief Publish/subscribe topics on top of queues.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_TOPIC_H
+#define MG_TOPIC_H
+
+#include "magnesium.h"
+#include "mg_shared.h"
+
+#ifndef MG_TOPIC_MAX
+#define MG_TOPIC_MAX 8
+#endif
+
+struct mg_topic_t {
+    struct mg_smp_protect_t lock;
+    struct mg_message_pool_t* envelopes;
+    struct mg_queue_t* subscribers[MG_TOPIC_MAX];
+    unsigned count;
+    unsigned epoch;
+    unsigned publishing[2]; /* Publishes still pushing, by epoch parity. */
+};
+
+static inline void mg_topic_init(
+    struct mg_topic_t* topic, 
+    struct mg_message_pool_t* envelopes
+) {
+    mg_smp_protect_init(&topic->lock);
+    topic->envelopes = envelopes;
+    topic->count = 0;
+    topic->epoch = 0;
+    topic->publishing[0] = 0;
+    topic->publishing[1] = 0;
+}
+
+static inline bool mg_topic_subscribe(struct mg_topic_t* topic, struct mg_queue_t* q) {
+    bool subscribed = false;
+    mg_smp_protect_acquire(&topic->lock);
+
+    if (topic->count < MG_TOPIC_MAX) {
+        topic->subscribers[topic->count++] = q;
+        subscribed = true;
+    }
+
+    mg_smp_protect_release(&topic->lock);
+    return subscribed;
+}
+
+/*
+ * Publishes register in the current epoch. The epoch advances only once the
+ * previous one is drained, so at most two epochs have publishes in flight.
+ * Should be called under the topic lock.
+ */
+static inline void _mg_topic_advance(struct mg_topic_t* topic) {
+    if (topic->publishing[(topic->epoch + 1) & 1] == 0) {
+        topic->epoch++;
+    }
+}
+
+/*
+ * Returns the epoch of publishes which may still deliver to the queue, it is
+ * passed to mg_topic_quiescent.
+ */
+static inline unsigned mg_topic_unsubscribe(struct mg_topic_t* topic, struct mg_queue_t* q) {
+    mg_smp_protect_acquire(&topic->lock);
+
+    for (unsigned i = 0; i < topic->count; ++i) {
+        if (topic->subscribers[i] == q) {
+            topic->subscribers[i] = topic->subscribers[--topic->count];
+            break;
+        }
+    }
+
+    const unsigned epoch = topic->epoch;
+    _mg_topic_advance(topic);
+    mg_smp_protect_release(&topic->lock);
+    return epoch;
+}
+
+/*
+ * Only publishes started before the unsubscription are waited for, so a
+ * busy topic becomes quiescent too. Polling is the only option, since 
+ * unsubscribing actor may preempt the publisher on the same CPU.
+ */
+static inline bool mg_topic_quiescent(struct mg_topic_t* topic, unsigned epoch) {
+    mg_smp_protect_acquire(&topic->lock);
+
+    if (topic->epoch == epoch) {
+        _mg_topic_advance(topic);
+    }
+
+    const unsigned passed = topic->epoch - epoch;
+    const bool quiescent = (passed > 1) || 
+        ((passed == 1) && (topic->publishing[epoch & 1] == 0));
+    mg_smp_protect_release(&topic->lock);
+    return quiescent;
+}
+
+/*
+ * Subscriber list is copied under the lock and messages are sent after its
+ * release, so publishing time is bounded by MG_TOPIC_MAX and subscription 
+ * changes never wait for publishers. As a consequence, a queue may receive
+ * a message published concurrently with its unsubscription.
+ */
+static inline bool mg_topic_publish(struct mg_topic_t* topic, struct mg_shared_t* payload) {
+    struct mg_queue_t* subscribers[MG_TOPIC_MAX];
+    mg_smp_protect_acquire(&topic->lock);
+    const unsigned count = topic->count;
+    const unsigned epoch = topic->epoch & 1;
+    ++topic->publishing[epoch];
+
+    for (unsigned i = 0; i < count; ++i) {
+        subscribers[i] = topic->subscribers[i];
+    }
+
+    mg_smp_protect_release(&topic->lock);
+    const bool sent = mg_shared_push(topic->envelopes, payload, subscribers, count);
+    mg_smp_protect_acquire(&topic->lock);
+    --topic->publishing[epoch];
+    mg_smp_protect_release(&topic->lock);
+    return sent;
+}
+
+#endif
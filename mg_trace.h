@@ -0,0 +1,187 @@
+/**
+  * @file  mg_trace.h
+  * @brief Per-CPU binary trace recorder based on kernel tracing hooks.
+  * License: BSD-2-Clause.
+  */
+
+#ifndef MG_TRACE_H
+#define MG_TRACE_H
+
+/*
+ * This header must be included instead of magnesium.h since it defines the
+ * tracing hooks. The port must provide mg_port_cycles() returning free
+ * running 32-bit cycle counter. Per-core counters (DWT->CYCCNT, mcycle) are
+ * fine for a single CPU, rings of several CPUs are comparable only if the
+ * counter is synchronized between them.
+ */
+#ifdef MAGNESIUM_H
+#error mg_trace.h must be included before magnesium.h.
+#endif
+
+#include <stdint.h>
+#include "mg_port.h"
+
+/*
+ * uint32_t is unsigned long on some targets (arm-none-eabi), so both integer
+ * types are checked. Without lock-free atomics (ARMv6-M) the port must 
+ * provide mg_port_irq_save() and mg_port_irq_restore(state), which unlike
+ * critical sections may nest, since hooks are called with interrupts masked.
+ */
+#if !defined(__STDC_NO_ATOMICS__)
+#   include <stdatomic.h>
+#   if (ATOMIC_INT_LOCK_FREE == 2) && (ATOMIC_LONG_LOCK_FREE == 2)
+#       define MG_TRACE_LOCK_FREE 1
+#   endif
+#endif
+
+#ifndef MG_TRACE_RING_LOG2
+#define MG_TRACE_RING_LOG2 8
+#endif
+
+#define MG_TRACE_RING_SIZE (1U << MG_TRACE_RING_LOG2)
+#define MG_TRACE_MAGIC 0x5254474DU /* "MGTR" in little-endian. */
+
+enum {
+    MG_TRACE_EV_ACTIVATE = 1,
+    MG_TRACE_EV_START,
+    MG_TRACE_EV_STOP,
+    MG_TRACE_EV_PUSH,
+    MG_TRACE_EV_POP,
+    MG_TRACE_EV_SUBSCRIBE,
+    MG_TRACE_EV_ALLOC,
+    MG_TRACE_EV_FREE,
+    MG_TRACE_EV_EMPTY,
+    MG_TRACE_EV_ARM,
+    MG_TRACE_EV_EXPIRE,
+    MG_TRACE_EV_LOCK,
+    MG_TRACE_EV_UNLOCK,
+};
+
+/*
+ * Object is the actor for actor and timer events, the queue for queue events
+ * and the pool for pool events. Arg is the message, the subscriber, the queue
+ * returned by actor or the timeout. Aux is the target CPU of activation.
+ * Pointers are truncated to 32 bits.
+ */
+struct mg_trace_event_t {
+    uint32_t cycles;
+    uint8_t type;
+    uint8_t vect;
+    uint16_t aux;
+    uint32_t object;
+    uint32_t arg;
+};
+
+struct mg_trace_ring_t {
+#ifdef MG_TRACE_LOCK_FREE
+    _Atomic uint32_t head;
+#else
+    uint32_t head;
+#endif
+    uint32_t reserved;
+    struct mg_trace_event_t events[MG_TRACE_RING_SIZE];
+};
+
+static inline void mg_trace_record(
+    unsigned type,
+    unsigned vect,
+    unsigned aux,
+    const void* object,
+    const void* arg
+);
+
+#define _MG_TRACE_PTR(p) ((const void*)(uintptr_t)(p))
+
+#define MG_TRACE_ACTOR_ACTIVATE(actor, cpu, vect) \
+    mg_trace_record(MG_TRACE_EV_ACTIVATE, (vect), (cpu), (actor), 0)
+#define MG_TRACE_ACTOR_START(actor, msg) \
+    mg_trace_record(MG_TRACE_EV_START, (actor)->vect, 0, (actor), (msg))
+#define MG_TRACE_ACTOR_STOP(actor, q) \
+    mg_trace_record(MG_TRACE_EV_STOP, (actor)->vect, 0, (actor), (q))
+#define MG_TRACE_QUEUE_PUSH(q, msg) \
+    mg_trace_record(MG_TRACE_EV_PUSH, 0, 0, (q), (msg))
+#define MG_TRACE_QUEUE_POP(q, msg) \
+    mg_trace_record(MG_TRACE_EV_POP, 0, 0, (q), (msg))
+#define MG_TRACE_QUEUE_SUBSCRIBE(q, actor) \
+    mg_trace_record(MG_TRACE_EV_SUBSCRIBE, (actor)->vect, 0, (q), (actor))
+#define MG_TRACE_POOL_ALLOC(pool, msg) \
+    mg_trace_record(MG_TRACE_EV_ALLOC, 0, 0, (pool), (msg))
+#define MG_TRACE_POOL_FREE(pool, msg) \
+    mg_trace_record(MG_TRACE_EV_FREE, 0, 0, (pool), (msg))
+#define MG_TRACE_POOL_EMPTY(pool) \
+    mg_trace_record(MG_TRACE_EV_EMPTY, 0, 0, (pool), 0)
+#define MG_TRACE_TIMER_ARM(actor, ticks) \
+    mg_trace_record(MG_TRACE_EV_ARM, (actor)->vect, 0, (actor), _MG_TRACE_PTR(ticks))
+#define MG_TRACE_TIMER_EXPIRE(actor) \
+    mg_trace_record(MG_TRACE_EV_EXPIRE, (actor)->vect, 0, (actor), 0)
+
+#ifdef MG_TRACE_LOCKS
+#define MG_TRACE_LOCK_ACQUIRE(lock) \
+    mg_trace_record(MG_TRACE_EV_LOCK, 0, 0, (lock), 0)
+#define MG_TRACE_LOCK_RELEASE(lock) \
+    mg_trace_record(MG_TRACE_EV_UNLOCK, 0, 0, (lock), 0)
+#endif
+
+#include "magnesium.h"
+
+/*
+ * The whole structure may be dumped from target memory and decoded by
+ * tools/mgtrace. All fields have fixed size, the header allows the decoder
+ * to find rings without knowing build options.
+ */
+struct mg_trace_t {
+    uint32_t magic;
+    uint16_t cpu_count;
+    uint16_t ring_size;
+    struct mg_trace_ring_t rings[MG_CPU_MAX];
+};
+
+extern struct mg_trace_t g_mg_trace;
+
+static inline void mg_trace_init(void) {
+    g_mg_trace.cpu_count = MG_CPU_MAX;
+    g_mg_trace.ring_size = MG_TRACE_RING_SIZE;
+
+    for (unsigned i = 0; i < MG_CPU_MAX; ++i) {
+#ifdef MG_TRACE_LOCK_FREE
+        atomic_init(&g_mg_trace.rings[i].head, 0);
+#else
+        g_mg_trace.rings[i].head = 0;
+#endif
+        g_mg_trace.rings[i].reserved = 0;
+    }
+
+    g_mg_trace.magic = MG_TRACE_MAGIC;
+}
+
+/*
+ * Each CPU writes only its own ring. Nested interrupts on the same CPU are
+ * handled by atomic slot reservation, so no locks are needed. Without atomics
+ * the reservation masks interrupts of this CPU for a few instructions. 
+ * The oldest events are overwritten.
+ */
+static inline void mg_trace_record(
+    unsigned type,
+    unsigned vect,
+    unsigned aux,
+    const void* object,
+    const void* arg
+) {
+    struct mg_trace_ring_t* const ring = &g_mg_trace.rings[mg_cpu_this()];
+#ifdef MG_TRACE_LOCK_FREE
+    const uint32_t i = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+#else
+    const unsigned state = mg_port_irq_save();
+    const uint32_t i = ring->head++;
+    mg_port_irq_restore(state);
+#endif
+    struct mg_trace_event_t* const event = &ring->events[i & (MG_TRACE_RING_SIZE - 1)];
+    event->cycles = mg_port_cycles();
+    event->type = (uint8_t) type;
+    event->vect = (uint8_t) vect;
+    event->aux = (uint16_t) aux;
+    event->object = (uint32_t)(uintptr_t) object;
+    event->arg = (uint32_t)(uintptr_t) arg;
+}
+
+#endif
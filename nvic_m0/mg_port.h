@@ -51,6 +51,20 @@ unsigned int mg_port_clz(uint32_t v) {
 #define mg_critical_section_enter() { asm volatile ("cpsid i"); }
 #define mg_critical_section_leave() { asm volatile ("cpsie i"); }
 
+/*
+ * Nestable interrupt masking used by mg_trace.h, since ARMv6-M has no atomic
+ * read-modify-write instructions.
+ */
+static inline unsigned mg_port_irq_save(void) {
+    unsigned primask;
+    asm volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) : : "memory");
+    return primask;
+}
+
+static inline void mg_port_irq_restore(unsigned primask) {
+    asm volatile ("msr primask, %0" : : "r" (primask) : "memory");
+}
+
 #define pic_vect2prio(v) \
     ((((volatile unsigned char*)0xE000E400)[v]) >> (8 - MG_NVIC_PRIO_BITS))
 
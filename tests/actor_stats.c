@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint32_t g_now = 0;
+#define mg_port_cycles() (g_now)
+#define MG_ACTOR_STATS
+
+#include "magnesium.h"
+#include "mg_top.h"
+#include "mocks.h"
+
+static struct mg_message_t g_msgs[4];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue_low;
+static struct mg_queue_t g_queue_high;
+static struct mg_actor_t g_low;
+static struct mg_actor_t g_high;
+struct mg_context_t g_mg_context;
+
+struct mg_queue_t* low_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    g_now += 100;
+    mg_queue_push(&g_queue_high, m);
+    g_now += 10;
+    return &g_queue_low;
+}
+
+struct mg_queue_t* high_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    g_now += 50;
+    mg_message_free(m);
+    return &g_queue_high;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue_low);
+    mg_queue_init(&g_queue_high);
+    mg_actor_init(&g_low, low_fn, 0, &g_queue_low);
+    mg_actor_init(&g_high, high_fn, 1, &g_queue_high);
+
+    for (unsigned i = 0; i < 2; ++i) {
+        struct mg_message_t* const msg = mg_message_alloc(&g_pool);
+        assert(msg != 0);
+        mg_queue_push(&g_queue_low, msg);
+    }
+
+    mg_context_schedule(0);
+    assert(g_low.stats.activations == 1);
+    assert(g_low.stats.messages == 2);
+    assert(g_low.stats.cycles == 220);
+    assert(g_low.stats.max_cycles == 110);
+    assert(g_low.stats.preempted == 100);
+    assert(g_high.stats.activations == 2);
+    assert(g_high.stats.messages == 2);
+    assert(g_high.stats.cycles == 100);
+    assert(g_high.stats.preempted == 0);
+
+    static const struct mg_top_entry_t entries[] = {
+        { "high", &g_high },
+        { "low", &g_low },
+    };
+    char buf[512];
+    const size_t len = mg_top_format(buf, sizeof(buf), entries, 2);
+    assert(len == strlen(buf));
+    const char* const low = strstr(buf, "low");
+    const char* const high = strstr(buf, "high");
+    assert(low && high && (low < high));
+    assert(strstr(low, " 68.7 "));
+
+    char small[16];
+    assert(mg_top_format(small, sizeof(small), entries, 2) == sizeof(small) - 1);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include "magnesium.h"
+#include "mg_arena.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { ARENA_SZ = 4096, SLOTS = 32, ROUNDS = 20000 };
+
+struct test_message_t {
+    struct mg_message_t header;
+    size_t len;
+    unsigned char payload[];
+};
+
+static unsigned char g_mem[ARENA_SZ];
+static struct mg_arena_t g_arena;
+static struct mg_actor_t g_actor;
+static struct mg_actor_t g_second;
+struct mg_context_t g_mg_context;
+static unsigned actor_calls = 0;
+static unsigned second_calls = 0;
+static struct mg_message_t* received = (struct mg_message_t*) 1;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    actor_calls++;
+    received = m;
+    assert(!mg_arena_alloc(&g_arena, ARENA_SZ)); /* Retry as consumers do. */
+    return (struct mg_queue_t*) &g_arena;
+}
+
+struct mg_queue_t* second_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    assert(m == 0);
+    second_calls++;
+    assert(!mg_arena_alloc(&g_arena, ARENA_SZ));
+    return (struct mg_queue_t*) &g_arena;
+}
+
+static struct test_message_t* alloc(size_t len) {
+    struct test_message_t* const msg = 
+        mg_arena_alloc(&g_arena, sizeof(struct test_message_t) + len);
+
+    if (msg) {
+        assert(((uintptr_t) msg % sizeof(void*)) == 0);
+        assert(((unsigned char*) msg >= g_mem) && ((unsigned char*) msg < g_mem + ARENA_SZ));
+        msg->len = len;
+        memset(msg->payload, (int) len, len);
+    }
+
+    return msg;
+}
+
+static void check_and_free(struct test_message_t* msg) {
+    for (size_t i = 0; i < msg->len; ++i) {
+        assert(msg->payload[i] == (unsigned char) msg->len);
+    }
+
+    mg_message_free(&msg->header);
+}
+
+int main(void) {
+    mg_context_init();
+    mg_arena_init(&g_arena, g_mem + 1, sizeof(g_mem) - 1);
+
+    struct test_message_t* const whole = alloc(ARENA_SZ / 2);
+    assert(whole);
+    assert(!alloc(ARENA_SZ / 2));
+    check_and_free(whole);
+
+    struct test_message_t* slots[SLOTS] = { 0 };
+    srand(1);
+
+    for (unsigned i = 0; i < ROUNDS; ++i) {
+        const unsigned j = (unsigned) rand() % SLOTS;
+
+        if (slots[j]) {
+            check_and_free(slots[j]);
+            slots[j] = 0;
+        } else {
+            slots[j] = alloc((size_t) rand() % 200);
+        }
+    }
+
+    for (unsigned j = 0; j < SLOTS; ++j) {
+        if (slots[j]) {
+            check_and_free(slots[j]);
+        }
+    }
+
+    /* Block freed between failed allocation and subscription is not lost. */
+    struct test_message_t* const early = alloc(ARENA_SZ / 2);
+    assert(early);
+    assert(!alloc(ARENA_SZ / 2));
+    check_and_free(early);
+    assert(!g_req);
+    mg_actor_init(&g_actor, actor_fn, 0, (struct mg_queue_t*) &g_arena);
+    assert(g_req && (g_arena.pool.queue.length == 0));
+    g_req = false;
+    mg_context_schedule(0);
+    assert((actor_calls == 1) && (received == 0));
+    assert(g_arena.pool.queue.length == -1);
+
+    struct test_message_t* const big = alloc(ARENA_SZ / 2);
+    assert(big);
+    assert(!alloc(ARENA_SZ / 2));
+    received = (struct mg_message_t*) 1;
+    check_and_free(big);
+    assert(g_req);
+    mg_context_schedule(0);
+    assert((actor_calls == 2) && (received == 0));
+    assert(g_arena.pool.queue.length == -1);
+    struct test_message_t* const held = alloc(ARENA_SZ / 2);
+    assert(held);
+
+    /* Free wakes the waiting actor, the one subscribing late is not lost. */
+    assert(!alloc(ARENA_SZ / 2));
+    g_req = false;
+    check_and_free(held);
+    assert(g_req && (g_arena.pool.queue.length == 0));
+    mg_actor_init(&g_second, second_fn, 0, (struct mg_queue_t*) &g_arena);
+    assert(g_arena.pool.queue.length == 0);
+    mg_context_schedule(0);
+    assert((actor_calls == 3) && (second_calls == 1));
+    assert(g_arena.pool.queue.length == -2);
+    assert(alloc(ARENA_SZ / 2));
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#define MG_MESSAGE_PRIO
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { MSGS = 4 };
+
+static struct mg_message_t g_msgs[MSGS];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+static const unsigned g_vects[] = { 0, 1 };
+static struct mg_message_t* received[MSGS];
+static unsigned level[MSGS];
+static unsigned count = 0;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    assert(count < MSGS);
+    received[count] = m;
+    level[count++] = self->prio;
+    mg_message_free(m);
+    return &g_queue;
+}
+
+static struct mg_message_t* push(unsigned prio) {
+    struct mg_message_t* const msg = mg_message_alloc(&g_pool);
+    assert(msg != 0);
+    msg->prio = prio;
+    mg_queue_push(&g_queue, msg);
+    return msg;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    mg_actor_init(&g_actor, actor_fn, 0, &g_queue);
+    mg_actor_bind(&g_actor, g_vects, 2);
+
+    struct mg_message_t* const urgent = push(5);
+    assert(count == 1);
+    assert((received[0] == urgent) && (level[0] == 1));
+    assert(!g_req);
+
+    struct mg_message_t* const bulk = push(0);
+    assert(g_req);
+    assert(count == 1);
+    struct mg_message_t* const urgent2 = push(1);
+    assert(count == 1);
+    g_req = false;
+    mg_context_schedule(0);
+    assert(count == 3);
+    assert((received[1] == bulk) && (level[1] == 0));
+    assert((received[2] == urgent2) && (level[2] == 1));
+    assert(g_actor.vect == 1);
+    assert(g_queue.length == -1);
+
+    return 0;
+}
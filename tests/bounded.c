@@ -0,0 +1,108 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#define MG_QUEUE_BOUNDED
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { MSGS = 8 };
+
+static struct mg_message_t g_msgs[MSGS];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_queue_t g_idle;
+static struct mg_actor_t g_producer;
+struct mg_context_t g_mg_context;
+static struct mg_message_t* sent[3];
+static bool producer_done = false;
+
+struct mg_queue_t* producer_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    static unsigned i;
+    MG_ACTOR_START;
+    assert(m == 0);
+
+    for (i = 0; i < 3; ++i) {
+        sent[i] = mg_message_alloc(&g_pool);
+        assert(sent[i] != 0);
+        MG_AWAIT(mg_queue_push_await(&g_queue, sent[i], self));
+        assert(m == 0);
+    }
+
+    producer_done = true;
+
+    for (;;) {
+        MG_AWAIT(&g_idle);
+    }
+
+    MG_ACTOR_END;
+}
+
+static struct mg_message_t* push3(void) {
+    struct mg_message_t* const first = mg_message_alloc(&g_pool);
+    assert(first != 0);
+    mg_queue_push(&g_queue, first);
+
+    for (unsigned i = 0; i < 2; ++i) {
+        struct mg_message_t* const msg = mg_message_alloc(&g_pool);
+        assert(msg != 0);
+        mg_queue_push(&g_queue, msg);
+    }
+
+    return first;
+}
+
+static void drain(void) {
+    struct mg_message_t* msg;
+
+    while ((msg = mg_queue_pop(&g_queue, 0)) != 0) {
+        mg_message_free(msg);
+    }
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    mg_queue_init(&g_idle);
+    g_queue.capacity = 2;
+
+    struct mg_message_t* first = push3();
+    assert(g_queue.length == 2);
+    assert(g_pool.queue.length == 1);
+    assert(mg_queue_pop(&g_queue, 0) == first);
+    mg_message_free(first);
+    drain();
+    assert(g_pool.queue.length == 3);
+
+    g_queue.flags = MG_QUEUE_DROP_OLDEST;
+    first = push3();
+    assert(g_queue.length == 2);
+    assert(g_pool.queue.length == 4);
+    struct mg_message_t* msg = mg_queue_pop(&g_queue, 0);
+    assert(msg != first);
+    mg_message_free(msg);
+    drain();
+
+    g_queue.capacity = 1;
+    mg_actor_init(&g_producer, producer_fn, 0, 0);
+    assert(g_queue.length == 1);
+    assert(!mg_fifo_empty(&g_queue.producers));
+    assert(!g_req);
+
+    for (unsigned i = 0; i < 3; ++i) {
+        msg = mg_queue_pop(&g_queue, 0);
+        assert(msg == sent[i]);
+        mg_message_free(msg);
+
+        if (i < 2) {
+            assert(g_req);
+            g_req = false;
+            mg_context_schedule(0);
+        }
+    }
+
+    assert(producer_done);
+    assert(g_queue.length == 0);
+    return 0;
+}
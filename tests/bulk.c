@@ -0,0 +1,65 @@
+#include <assert.h>
+#include <stdbool.h>
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { MSGS = 8 };
+
+static struct mg_message_t g_msgs[MSGS];
+static struct mg_message_pool_t g_pool;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+static struct mg_message_t* received = 0;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+
+    if (!received) {
+        received = m;
+    }
+
+    return &g_pool.queue;
+}
+
+static size_t chain_length(struct mg_fifo_t* chain) {
+    size_t n = 0;
+
+    for (struct mg_node_t* p = chain->dummy.next; p != 0; p = p->next) {
+        struct mg_message_t* const msg = mg_fifo_entry(p, struct mg_message_t, link);
+        assert(msg->parent == &g_pool);
+        ++n;
+    }
+
+    return n;
+}
+
+int main(void) {
+    struct mg_fifo_t chain1, chain2;
+    mg_fifo_init(&chain1);
+    mg_fifo_init(&chain2);
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+
+    assert(mg_message_alloc_n(&g_pool, &chain1, 5) == 5);
+    assert(chain_length(&chain1) == 5);
+    mg_message_free_n(&chain1);
+    assert(mg_fifo_empty(&chain1));
+    assert(g_pool.queue.length == 5);
+
+    assert(mg_message_alloc_n(&g_pool, &chain2, 10) == MSGS);
+    assert(chain_length(&chain2) == MSGS);
+    assert(g_pool.queue.length == 0);
+    assert(mg_message_alloc_n(&g_pool, &chain1, 1) == 0);
+
+    mg_actor_init(&g_actor, actor_fn, 0, &g_pool.queue);
+    struct mg_message_t* const first = 
+        mg_fifo_entry(chain2.dummy.next, struct mg_message_t, link);
+    mg_message_free_n(&chain2);
+    assert(g_req);
+    assert(g_pool.queue.length == MSGS - 1);
+    mg_context_schedule(0);
+    assert(received == first);
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#define MG_QUEUE_HOOKS
+#define MG_QUEUE_BOUNDED
+#include "magnesium.h"
+#include "mg_coalesce.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { MSGS = 24, KEYS = 20 };
+
+static struct mg_keyed_t g_msgs[MSGS];
+static struct mg_message_pool_t g_pool;
+static struct mg_coalesce_queue_t g_queue;
+struct mg_context_t g_mg_context;
+
+static struct mg_message_t* push(uintptr_t key) {
+    struct mg_keyed_t* const msg = mg_message_alloc(&g_pool);
+    assert(msg != 0);
+    msg->key = key;
+    mg_queue_push(&g_queue.queue, &msg->header);
+    return &msg->header;
+}
+
+static struct mg_message_t* pop(void) {
+    struct mg_message_t* const msg = mg_queue_pop(&g_queue.queue, 0);
+    assert(msg != 0);
+    mg_message_free(msg);
+    return msg;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+
+    mg_coalesce_queue_init(&g_queue, false);
+    struct mg_message_t* const a = push(1);
+    struct mg_message_t* const b = push(2);
+    push(1);
+    assert(g_queue.queue.length == 2);
+    assert(g_pool.queue.length == 1);
+    assert(pop() == a);
+    assert(pop() == b);
+    assert(g_queue.queue.length == 0);
+    assert((g_queue.head == 0) && (g_queue.tail == 0));
+
+    mg_coalesce_queue_init(&g_queue, true);
+    push(1);
+    struct mg_message_t* const d = push(2);
+    struct mg_message_t* const e = push(1);
+    struct mg_message_t* const f = push(2);
+    assert(g_queue.queue.length == 2);
+    assert(pop() == e);
+    assert(pop() == f);
+    assert(d != f);
+
+    struct mg_message_t* msgs[KEYS];
+
+    for (unsigned i = 0; i < KEYS; ++i) {
+        msgs[i] = push(i * MG_COALESCE_BUCKETS);
+    }
+
+    struct mg_message_t* const last = push(7 * MG_COALESCE_BUCKETS);
+    msgs[7] = last;
+    assert(g_queue.queue.length == KEYS);
+
+    for (unsigned i = 0; i < KEYS; ++i) {
+        assert(pop() == msgs[i]);
+    }
+
+    for (unsigned i = 0; i < MG_COALESCE_BUCKETS; ++i) {
+        assert(g_queue.buckets[i] == 0);
+    }
+
+    /* Replacement does not grow a full bounded queue, so it is not dropped. */
+    g_queue.queue.capacity = 1;
+    push(7);
+    struct mg_message_t* const fresh = push(7);
+    push(8);
+    assert(g_queue.queue.length == 1);
+    assert(g_pool.queue.length == MSGS - 1);
+    assert(pop() == fresh);
+    assert((g_queue.head == 0) && (g_queue.tail == 0));
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#define MG_HANDOFF
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+static struct mg_message_t g_msgs[1];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_stage1;
+static struct mg_queue_t g_stage2;
+static struct mg_actor_t g_actor1;
+static struct mg_actor_t g_actor2;
+struct mg_context_t g_mg_context;
+
+static bool actor1_done = false;
+static bool actor2_done = false;
+
+struct mg_queue_t* actor1_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    mg_queue_push(&g_stage2, m);
+    assert(!actor2_done);
+    actor1_done = true;
+    return &g_stage1;
+}
+
+struct mg_queue_t* actor2_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    assert(actor1_done);
+    actor2_done = true;
+    mg_message_free(m);
+    return &g_stage2;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_stage1);
+    mg_queue_init(&g_stage2);
+    g_stage2.flags = MG_QUEUE_HANDOFF;
+    mg_actor_init(&g_actor1, actor1_fn, 0, &g_stage1);
+    mg_actor_init(&g_actor2, actor2_fn, 0, &g_stage2);
+    
+    struct mg_message_t* const m = mg_message_alloc(&g_pool);
+    assert(m);
+    mg_queue_push(&g_stage1, m);
+    assert(g_req);
+    g_req = false;
+    mg_context_schedule(0);
+    assert(actor1_done && actor2_done);
+    assert(!g_req);
+    assert(g_mg_context.per_cpu_data[0].active == 0);
+
+    actor2_done = false;
+    mg_queue_push(&g_stage2, mg_message_alloc(&g_pool));
+    assert(g_req && !actor2_done);
+    mg_context_schedule(0);
+    assert(actor2_done);
+
+    return 0;
+}
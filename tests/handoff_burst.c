@@ -0,0 +1,75 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#define MG_HANDOFF
+#include "magnesium.h"
+#include "mocks.h"
+
+#define HOPS 20
+
+static struct mg_message_t g_msgs[2];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_ping;
+static struct mg_queue_t g_pong;
+static struct mg_queue_t g_other;
+static struct mg_actor_t g_pinger;
+static struct mg_actor_t g_ponger;
+static struct mg_actor_t g_bystander;
+struct mg_context_t g_mg_context;
+
+static unsigned hops = 0;
+static unsigned hops_seen = 0;
+
+struct mg_queue_t* pinger_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+
+    if (++hops < HOPS) {
+        mg_queue_push(&g_pong, m);
+    } else {
+        mg_message_free(m);
+    }
+
+    return &g_ping;
+}
+
+struct mg_queue_t* ponger_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+
+    if (++hops < HOPS) {
+        mg_queue_push(&g_ping, m);
+    } else {
+        mg_message_free(m);
+    }
+
+    return &g_pong;
+}
+
+struct mg_queue_t* bystander_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    hops_seen = hops;
+    mg_message_free(m);
+    return &g_other;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_ping);
+    mg_queue_init(&g_pong);
+    mg_queue_init(&g_other);
+    g_ping.flags = MG_QUEUE_HANDOFF;
+    g_pong.flags = MG_QUEUE_HANDOFF;
+    mg_actor_init(&g_pinger, pinger_fn, 0, &g_ping);
+    mg_actor_init(&g_ponger, ponger_fn, 0, &g_pong);
+    mg_actor_init(&g_bystander, bystander_fn, 0, &g_other);
+
+    mg_queue_push(&g_ping, mg_message_alloc(&g_pool));
+    mg_queue_push(&g_other, mg_message_alloc(&g_pool));
+    mg_context_schedule(0);
+
+    /* Bystander runs after at most MG_HANDOFF_BURST handoffs, not at the end. */
+    assert(hops == HOPS);
+    assert(hops_seen == MG_HANDOFF_BURST + 1);
+    assert(g_mg_context.per_cpu_data[0].active == 0);
+    return 0;
+}
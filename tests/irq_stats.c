@@ -0,0 +1,73 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint32_t g_now = 0;
+static uint32_t g_step = 3;
+#define mg_port_cycles() (g_now += g_step)
+#define MG_IRQ_STATS
+
+#include "magnesium.h"
+#include "mocks.h"
+
+static struct mg_message_t g_msgs[2];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+struct mg_context_t g_mg_context;
+struct mg_irq_stats_t g_mg_irq_stats;
+
+static unsigned total(const struct mg_irq_site_t* site) {
+    unsigned sum = 0;
+
+    for (unsigned i = 0; i < MG_IRQ_BUCKETS; ++i) {
+        sum += site->histogram[0][i];
+    }
+
+    return sum;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    assert(mg_irq_sites() == 0);
+
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    unsigned count = 0;
+
+    for (const struct mg_irq_site_t* s = mg_irq_sites(); s; s = s->next) {
+        assert(s->max[0] == 3);
+        assert(s->histogram[0][1] == total(s));
+        ++count;
+    }
+
+    assert(count >= 2);
+
+    g_step = 1000;
+    struct mg_message_t* const msg = mg_queue_pop(&g_queue, 0);
+    assert(msg != 0);
+    g_step = 3;
+    mg_message_free(msg);
+
+    mg_smp_protect_acquire(&g_queue.lock);
+    g_now += 100000;
+    mg_smp_protect_release(&g_queue.lock);
+
+    const struct mg_irq_site_t* long_site = 0;
+    const struct mg_irq_site_t* pop_site = 0;
+
+    for (const struct mg_irq_site_t* s = mg_irq_sites(); s; s = s->next) {
+        if (strcmp(s->func, "main") == 0) {
+            long_site = s;
+        } else if (strcmp(s->func, "mg_queue_pop") == 0) {
+            pop_site = s;
+        }
+    }
+
+    assert(long_site && (long_site->max[0] == 100003));
+    assert(long_site->histogram[0][MG_IRQ_BUCKETS - 1] == 1);
+    assert(pop_site && (pop_site->max[0] == 1000));
+    assert(pop_site->histogram[0][9] == 1);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+static uint32_t g_now = 0;
+#define mg_port_cycles() (g_now)
+#define MG_LATENCY_STATS
+
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+static struct mg_message_t g_msgs[2];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    mg_message_free(m);
+    return &g_queue;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    mg_actor_init(&g_actor, actor_fn, 0, &g_queue);
+
+    g_now = 0xfffffff0U;
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    g_now += 300;
+    mg_context_schedule(0);
+
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    mg_context_schedule(0);
+
+    const uint32_t* const hist = mg_latency_histogram(0, 0);
+    assert(hist[8] == 1);
+    assert(hist[0] == 1);
+
+    unsigned total = 0;
+
+    for (unsigned i = 0; i < MG_LATENCY_BUCKETS; ++i) {
+        total += hist[i];
+    }
+
+    assert(total == 2);
+    assert(mg_latency_histogram(0, 1)[0] == 0);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#define MG_CPU_MAX 2
+#include <assert.h>
+#include <stdbool.h>
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+static struct mg_message_t g_msgs[2];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_actor1;
+static struct mg_actor_t g_actor2;
+struct mg_context_t g_mg_context;
+
+static unsigned g_cpu = 0;
+static unsigned actor1_calls = 0;
+static unsigned actor2_calls = 0;
+
+unsigned int mg_cpu_this(void) {
+    return g_cpu;
+}
+
+struct mg_queue_t* actor1_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    actor1_calls++;
+    mg_message_free(m);
+    return &g_queue;
+}
+
+struct mg_queue_t* actor2_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    actor2_calls++;
+    mg_message_free(m);
+    return &g_queue;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    g_queue.flags = MG_QUEUE_LOCAL_FIRST;
+    g_cpu = 1;
+    mg_actor_init(&g_actor1, actor1_fn, 0, &g_queue);
+    g_cpu = 0;
+    mg_actor_init(&g_actor2, actor2_fn, 0, &g_queue);
+
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    assert(g_req && (g_req_cpu == 0));
+    mg_context_schedule(0);
+    assert((actor1_calls == 0) && (actor2_calls == 1));
+
+    g_cpu = 1;
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    assert(g_req_cpu == 1);
+    mg_context_schedule(0);
+    assert((actor1_calls == 1) && (actor2_calls == 1));
+
+    g_cpu = 0;
+    mg_queue_init(&g_queue);
+    g_queue.flags = MG_QUEUE_LOCAL_FIRST;
+    g_cpu = 1;
+    mg_actor_init(&g_actor1, actor1_fn, 0, &g_queue);
+    g_cpu = 0;
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    assert(g_req_cpu == 1);
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+static uint32_t g_now = 0;
+#define mg_port_cycles() (g_now)
+#define MG_MESSAGE_STATS
+
+#include "magnesium.h"
+#include "mocks.h"
+
+static struct mg_message_t g_msgs[2];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_stage1;
+static struct mg_queue_t g_stage2;
+static struct mg_queue_t g_direct;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    assert(m->hops == 1);
+    mg_message_free(m);
+    return &g_direct;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_stage1);
+    mg_queue_init(&g_stage2);
+    mg_queue_init(&g_direct);
+    mg_actor_init(&g_actor, actor_fn, 0, &g_direct);
+
+    g_now = 1000;
+    struct mg_message_t* msg = mg_message_alloc(&g_pool);
+    assert((msg->born == 1000) && (msg->hops == 0));
+
+    g_now = 1010;
+    mg_queue_push(&g_stage1, msg);
+    g_now = 1110;
+    msg = mg_queue_pop(&g_stage1, 0);
+    assert(g_stage1.residency[6] == 1);
+
+    mg_queue_push(&g_stage2, msg);
+    g_now = 2110;
+    msg = mg_queue_pop(&g_stage2, 0);
+    assert(g_stage2.residency[9] == 1);
+    assert((msg->hops == 2) && (msg->stamp == 1110));
+
+    g_now = 6000;
+    mg_message_free(msg);
+    assert(g_pool.lifetime[12] == 1);
+
+    msg = mg_message_alloc(&g_pool);
+    assert(msg->hops == 0);
+    mg_queue_push(&g_direct, msg);
+    assert(g_direct.residency[0] == 1);
+    mg_context_schedule(0);
+    assert(g_pool.lifetime[0] == 1);
+
+    unsigned total = 0;
+
+    for (unsigned i = 0; i < MG_RESIDENCY_BUCKETS; ++i) {
+        total += g_stage1.residency[i] + g_stage2.residency[i] + g_direct.residency[i];
+    }
+
+    assert(total == 3);
+
+    g_now = 6100;
+    msg = mg_message_alloc(&g_pool);
+    assert(g_pool.queue.residency[6] == 1);
+    mg_message_free(msg);
+
+    struct mg_fifo_t chain;
+    mg_fifo_init(&chain);
+    assert(mg_message_alloc_n(&g_pool, &chain, 2) == 2);
+    g_now = 6200;
+    mg_message_free_n(&chain);
+    assert(g_pool.lifetime[6] == 2);
+    return 0;
+}
@@ -13,7 +13,14 @@
 #define pic_vect2prio(v) (v)
 #define mg_critical_section_enter()
 #define mg_critical_section_leave() 
+
+#ifdef MG_CPU_MAX
+#define mg_port_wait_event()
+#define mg_port_send_event()
+extern unsigned int mg_cpu_this(void);
+#else
 #define mg_cpu_this() 0
+#endif
 
 extern void pic_interrupt_request(unsigned int cpu, unsigned int vect);
 
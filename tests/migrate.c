@@ -0,0 +1,115 @@
+#define MG_CPU_MAX 2
+#include <assert.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "magnesium.h"
+#include <stdio.h>
+
+#define UNUSED_ARG(arg) (void)(arg)
+
+//
+// Host SMP stress test. Each thread emulates a CPU: interrupt requests set
+// pending bits which are polled by the thread owning that CPU. CPU 0 produces
+// messages, CPU 1 keeps migrating the consumer back and forth while it is 
+// waiting, sleeping or queued for execution.
+//
+enum {
+    MESSAGES = 200000,
+    SLEEP_PERIOD = 7,
+    TICK_PERIOD = 64,
+    MIGRATE_PERIOD = 16,
+};
+
+static struct mg_message_t g_msgs[8];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+
+static _Thread_local unsigned g_cpu = 0;
+static atomic_uint g_pending[MG_CPU_MAX];
+static atomic_uint g_runs[MG_CPU_MAX];
+static atomic_bool g_running;
+static atomic_bool g_done;
+static atomic_uint g_processed;
+static unsigned g_calls = 0;
+
+unsigned int mg_cpu_this(void) {
+    return g_cpu;
+}
+
+void pic_interrupt_request(unsigned int cpu, unsigned int v) {
+    atomic_fetch_or(&g_pending[cpu], 1U << v);
+}
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    const bool was_running = atomic_exchange(&g_running, true);
+    assert(!was_running);
+    (void) was_running;
+    atomic_fetch_add(&g_runs[mg_cpu_this()], 1);
+
+    if (m) {
+        mg_message_free(m);
+        atomic_fetch_add(&g_processed, 1);
+    }
+
+    const bool sleep = (++g_calls % SLEEP_PERIOD) == 0;
+    atomic_store(&g_running, false);
+    return sleep ? mg_sleep_for(1, self) : &g_queue;
+}
+
+static void* cpu_main(void* arg) {
+    g_cpu = (unsigned)(uintptr_t) arg;
+    unsigned produced = 0;
+
+    for (unsigned i = 0; !atomic_load(&g_done); ++i) {
+        if (atomic_exchange(&g_pending[g_cpu], 0)) {
+            mg_context_schedule(0);
+        }
+
+        if ((i % TICK_PERIOD) == 0) {
+            mg_context_tick();
+        }
+
+        if (g_cpu == 0) {
+            struct mg_message_t* const msg = 
+                (produced < MESSAGES) ? mg_message_alloc(&g_pool) : 0;
+
+            if (msg) {
+                mg_queue_push(&g_queue, msg);
+                ++produced;
+            }
+        } else if ((i % MIGRATE_PERIOD) == 0) {
+            mg_actor_migrate(&g_actor, (i / MIGRATE_PERIOD) % MG_CPU_MAX);
+        }
+    }
+
+    return 0;
+}
+
+int main(void) {
+    pthread_t threads[MG_CPU_MAX];
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    mg_actor_init(&g_actor, actor_fn, 0, &g_queue);
+
+    for (unsigned i = 0; i < MG_CPU_MAX; ++i) {
+        pthread_create(&threads[i], 0, cpu_main, (void*)(uintptr_t) i);
+    }
+
+    while (atomic_load(&g_processed) != MESSAGES) {
+        ;
+    }
+
+    atomic_store(&g_done, true);
+
+    for (unsigned i = 0; i < MG_CPU_MAX; ++i) {
+        pthread_join(threads[i], 0);
+    }
+
+    assert(atomic_load(&g_runs[0]) && atomic_load(&g_runs[1]));
+    return 0;
+}
@@ -8,6 +8,8 @@
 #define UNUSED_ARG(arg) (void)(arg)
 
 static bool g_req = false;
+static unsigned int g_req_cpu = 0;
+static unsigned int g_req_count = 0;
 
 //
 // By default all actors in unit tests must use single priority 0. Interrupt
@@ -16,7 +18,8 @@ static bool g_req = false;
 // way when activation of actor with priority 1 causes immediate preemption.
 //
 void pic_interrupt_request(unsigned int cpu, unsigned int v) {
-    UNUSED_ARG(cpu);
+    g_req_cpu = cpu;
+    g_req_count++;
 
     if (v == 1) {
         mg_context_schedule(1);        
@@ -0,0 +1,60 @@
+#include <assert.h>
+#include <stdbool.h>
+#include "magnesium.h"
+#include "mg_pool_set.h"
+#include "mocks.h"
+#include <stdio.h>
+
+static struct small_message_t {
+    struct mg_message_t header;
+    unsigned char payload[4];
+} g_small[2];
+
+static struct large_message_t {
+    struct mg_message_t header;
+    unsigned char payload[64];
+} g_large[1];
+
+static struct mg_message_pool_t g_small_pool;
+static struct mg_message_pool_t g_large_pool;
+static struct mg_pool_set_t g_set;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+static struct mg_message_t* received = 0;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    received = m;
+    return mg_pool_set_queue(&g_set, sizeof(struct large_message_t));
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_small_pool, &g_small, sizeof(g_small), sizeof(g_small[0]));
+    mg_message_pool_init(&g_large_pool, &g_large, sizeof(g_large), sizeof(g_large[0]));
+    struct mg_message_pool_t* const pools[] = { &g_small_pool, &g_large_pool };
+    mg_pool_set_init(&g_set, pools, 2);
+
+    struct mg_message_t* const s1 = mg_message_alloc_sized(&g_set, 3);
+    struct mg_message_t* const s2 = mg_message_alloc_sized(&g_set, sizeof(struct small_message_t));
+    assert(s1 && s2);
+    assert((s1->parent == &g_small_pool) && (s2->parent == &g_small_pool));
+    assert(!mg_message_alloc_sized(&g_set, 1));
+
+    struct mg_message_t* const l = mg_message_alloc_sized(&g_set, sizeof(struct large_message_t));
+    assert(l && (l->parent == &g_large_pool));
+    assert(!mg_message_alloc_sized(&g_set, sizeof(struct small_message_t) + 1));
+    assert(!mg_message_alloc_sized(&g_set, sizeof(struct large_message_t) + 1));
+    assert(!mg_pool_set_queue(&g_set, sizeof(struct large_message_t) + 1));
+
+    mg_actor_init(&g_actor, actor_fn, 0, mg_pool_set_queue(&g_set, sizeof(struct large_message_t)));
+    mg_message_free(s1);
+    assert(!g_req);
+    mg_message_free(l);
+    assert(g_req);
+    mg_context_schedule(0);
+    assert(received == l);
+    mg_message_free(s2);
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#define MG_MESSAGE_PRIO
+#define MG_QUEUE_HOOKS
+#define MG_QUEUE_BOUNDED
+#include "magnesium.h"
+#include "mg_prio_queue.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { MSGS = 8 };
+
+static struct mg_message_t g_msgs[MSGS];
+static struct mg_message_pool_t g_pool;
+static struct mg_prio_queue_t g_queue;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+static struct mg_message_t* received[3];
+static unsigned count = 0;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    assert(count < 3);
+    received[count++] = m;
+    return &g_queue.queue;
+}
+
+static struct mg_message_t* push(unsigned prio) {
+    struct mg_message_t* const msg = mg_message_alloc(&g_pool);
+    assert(msg != 0);
+    assert(msg->prio == 0);
+    msg->prio = prio;
+    mg_queue_push(&g_queue.queue, msg);
+    return msg;
+}
+
+int main(void) {
+    static const unsigned prio[] = { 0, 3, 1, 3, 7 };
+    static const unsigned order[] = { 4, 1, 3, 2, 0 };
+    struct mg_message_t* msgs[5];
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_prio_queue_init(&g_queue);
+
+    for (unsigned i = 0; i < 5; ++i) {
+        msgs[i] = push(prio[i]);
+    }
+
+    assert(g_queue.queue.length == 5);
+
+    for (unsigned i = 0; i < 5; ++i) {
+        struct mg_message_t* const msg = mg_queue_pop(&g_queue.queue, 0);
+        assert(msg == msgs[order[i]]);
+        mg_message_free(msg);
+    }
+
+    assert(g_queue.bitmap == 0);
+    assert(mg_queue_pop(&g_queue.queue, 0) == 0);
+
+    /* Full queue drops the least urgent message, not the next one to pop. */
+    g_queue.queue.capacity = 3;
+    g_queue.queue.flags = MG_QUEUE_DROP_OLDEST;
+    msgs[0] = push(5);
+    msgs[1] = push(1);
+    msgs[2] = push(1);
+    msgs[3] = push(6);
+    assert(g_queue.queue.length == 3);
+    assert(mg_queue_pop(&g_queue.queue, 0) == msgs[3]);
+    assert(mg_queue_pop(&g_queue.queue, 0) == msgs[0]);
+    assert(mg_queue_pop(&g_queue.queue, 0) == msgs[2]);
+    assert(g_queue.bitmap == 0);
+    assert(g_pool.queue.length == MSGS - 3);
+
+    for (unsigned i = 0; i < 4; ++i) {
+        if (i != 1) {
+            mg_message_free(msgs[i]);
+        }
+    }
+
+    g_queue.queue.capacity = 0;
+    g_queue.queue.flags = 0;
+
+    mg_actor_init(&g_actor, actor_fn, 0, &g_queue.queue);
+    struct mg_message_t* const first = push(2);
+    assert(g_req);
+    g_req = false;
+    struct mg_message_t* const bulk = push(1);
+    struct mg_message_t* const urgent = push(5);
+    mg_context_schedule(0);
+    assert(count == 3);
+    assert(received[0] == first);
+    assert(received[1] == urgent);
+    assert(received[2] == bulk);
+    assert(g_queue.queue.length == -1);
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#define MG_QUEUE_STATS
+#define MG_QUEUE_BOUNDED
+
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { MSGS = 4 };
+
+static struct mg_message_t g_msgs[MSGS];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    mg_message_free(m);
+    return &g_queue;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    assert((g_pool.stats.unused == MSGS) && (g_pool.stats.min_free == MSGS));
+
+    for (unsigned i = 0; i < 3; ++i) {
+        struct mg_message_t* const msg = mg_message_alloc(&g_pool);
+        assert(msg != 0);
+        mg_queue_push(&g_queue, msg);
+    }
+
+    assert(g_pool.stats.min_free == 1);
+    assert(g_queue.stats.pushes == 3);
+    assert(g_queue.stats.max_length == 3);
+
+    for (unsigned i = 0; i < 3; ++i) {
+        mg_message_free(mg_queue_pop(&g_queue, 0));
+    }
+
+    assert(g_queue.stats.pops == 3);
+    assert(g_pool.queue.stats.pushes == 3);
+    assert(g_pool.queue.stats.pops == 3);
+
+    struct mg_fifo_t chain;
+    mg_fifo_init(&chain);
+    assert(mg_message_alloc_n(&g_pool, &chain, 5) == MSGS);
+    assert(g_pool.stats.min_free == 0);
+    assert(g_pool.stats.failures == 1);
+    assert(mg_message_alloc(&g_pool) == 0);
+    assert(g_pool.stats.failures == 2);
+    assert(g_pool.queue.stats.pops == 3 + MSGS);
+
+    mg_actor_init(&g_actor, actor_fn, 0, &g_queue);
+    assert((g_queue.stats.waits == 1) && (g_queue.stats.max_waiting == 1));
+    mg_queue_push_chain(&g_queue, &chain);
+    assert(g_queue.stats.pushes == 3 + MSGS);
+    assert(g_queue.stats.pops == 4);
+    assert(g_queue.stats.max_length == 3);
+    mg_context_schedule(0);
+    assert(g_queue.stats.pops == 3 + MSGS);
+    assert(g_queue.stats.waits == 2);
+    assert(g_pool.stats.min_free == 0);
+
+    struct mg_queue_t bounded;
+    mg_queue_init(&bounded);
+    bounded.capacity = 1;
+    mg_queue_push(&bounded, mg_message_alloc(&g_pool));
+    assert(bounded.stats.drops == 0);
+    mg_queue_push(&bounded, mg_message_alloc(&g_pool));
+    assert((bounded.stats.drops == 1) && (bounded.stats.pushes == 2));
+    assert(bounded.stats.max_length == 1);
+    return 0;
+}
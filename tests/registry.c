@@ -0,0 +1,72 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MG_REGISTRY
+#include "mg_snapshot.h"
+#include "mocks.h"
+
+static struct mg_message_t g_msgs[4];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_waiter;
+static struct mg_actor_t g_sleeper;
+static struct mg_snapshot_t g_snap;
+struct mg_context_t g_mg_context;
+
+struct mg_queue_t* waiter_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    mg_message_free(m);
+    return &g_queue;
+}
+
+struct mg_queue_t* sleeper_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(m);
+    return mg_sleep_for(10, self);
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    g_pool.name = "pool";
+    mg_queue_init(&g_queue);
+    mg_queue_init(&g_queue);
+    g_queue.name = "a very long queue name";
+    mg_actor_init(&g_waiter, waiter_fn, 0, &g_queue);
+    g_waiter.name = "waiter";
+    mg_actor_init(&g_sleeper, sleeper_fn, 0, 0);
+    g_sleeper.name = "sleeper";
+
+    assert(mg_registry_next_queue(0) == &g_queue);
+    assert(mg_registry_next_queue(&g_queue) == 0);
+    assert(mg_registry_next_pool(0) == &g_pool);
+    assert(mg_actor_state(&g_waiter) == MG_ACTOR_WAITING);
+    assert(g_waiter.waiting == &g_queue);
+    assert(mg_actor_state(&g_sleeper) == MG_ACTOR_SLEEPING);
+
+    struct mg_message_t* const msg = mg_message_alloc(&g_pool);
+    assert(mg_pool_free_count(&g_pool) == 3);
+    mg_queue_push(&g_queue, msg);
+    assert(mg_actor_state(&g_waiter) == MG_ACTOR_RUNNABLE);
+
+    mg_snapshot_take(&g_snap);
+    assert(g_snap.magic == MG_SNAPSHOT_MAGIC);
+    assert(g_snap.sequence == 2);
+    assert((g_snap.actor_count == 2) && (g_snap.queue_count == 1) && (g_snap.pool_count == 1));
+    assert(strcmp(g_snap.actors[0].name, "sleeper") == 0);
+    assert(g_snap.actors[0].state == MG_ACTOR_SLEEPING);
+    assert(strcmp(g_snap.actors[1].name, "waiter") == 0);
+    assert(g_snap.actors[1].state == MG_ACTOR_RUNNABLE);
+    assert(strcmp(g_snap.queues[0].name, "a very long que") == 0);
+    assert(g_snap.queues[0].length == 0);
+    assert((g_snap.pools[0].blocks == 4) && (g_snap.pools[0].free == 3));
+
+    mg_context_schedule(0);
+    mg_snapshot_take(&g_snap);
+    assert(g_snap.sequence == 4);
+    assert(g_snap.actors[1].state == MG_ACTOR_WAITING);
+    assert(g_snap.actors[1].queue == (uint32_t)(uintptr_t) &g_queue);
+    assert(g_snap.queues[0].length == -1);
+    assert(g_snap.pools[0].free == 4);
+    return 0;
+}
@@ -6,7 +6,7 @@ error() {
 }
 
 for f in *.c; do
-    gcc -O2 -std=c99 -Wextra -fanalyzer -pedantic -Wall -o $f.test -I .. -I . $f 
+    gcc -O2 -std=c11 -Wextra -fanalyzer -pedantic -Wall -pthread -o $f.test -I .. -I . $f 
     if [ $? -ne 0 ]; then error 
     fi
     ./$f.test
@@ -0,0 +1,93 @@
+#define MG_CPU_MAX 2
+#include <assert.h>
+#include <stdbool.h>
+#include "magnesium.h"
+#include "mg_scatter.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { ITEMS = 6 };
+
+static struct mg_work_t g_items[ITEMS];
+static struct mg_message_t g_join[1];
+static struct mg_message_pool_t g_item_pool;
+static struct mg_message_pool_t g_join_pool;
+static struct mg_queue_t g_worker_queue[MG_CPU_MAX];
+static struct mg_queue_t g_reply;
+static struct mg_actor_t g_workers[MG_CPU_MAX];
+static struct mg_actor_t g_coordinator;
+static struct mg_scatter_t g_scatter;
+struct mg_context_t g_mg_context;
+
+static unsigned g_cpu = 0;
+static unsigned handled[MG_CPU_MAX] = { 0 };
+static bool joined = false;
+
+unsigned int mg_cpu_this(void) {
+    return g_cpu;
+}
+
+struct mg_queue_t* worker_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    assert(self->cpu == mg_cpu_this());
+    handled[self->cpu]++;
+    mg_scatter_complete((struct mg_work_t*) m);
+    return &g_worker_queue[self->cpu];
+}
+
+struct mg_queue_t* coordinator_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    MG_ACTOR_START;
+
+    mg_scatter_begin(&g_scatter, mg_message_alloc(&g_join_pool), &g_reply);
+
+    for (unsigned i = 0; i < ITEMS; ++i) {
+        struct mg_work_t* const item = mg_message_alloc(&g_item_pool);
+        assert(item);
+        mg_scatter_add(&g_scatter, item);
+    }
+
+    mg_scatter_commit(&g_scatter);
+    MG_AWAIT(&g_reply);
+    joined = true;
+    mg_message_free(m);
+
+    for (;;) {
+        MG_AWAIT(&g_reply);
+    }
+
+    MG_ACTOR_END;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_item_pool, &g_items, sizeof(g_items), sizeof(g_items[0]));
+    mg_message_pool_init(&g_join_pool, &g_join, sizeof(g_join), sizeof(g_join[0]));
+    mg_queue_init(&g_reply);
+    struct mg_queue_t* workers[MG_CPU_MAX];
+
+    for (unsigned i = 0; i < MG_CPU_MAX; ++i) {
+        g_cpu = i;
+        mg_queue_init(&g_worker_queue[i]);
+        mg_actor_init(&g_workers[i], worker_fn, 0, &g_worker_queue[i]);
+        workers[i] = &g_worker_queue[i];
+    }
+
+    g_cpu = 0;
+    mg_scatter_init(&g_scatter, workers, MG_CPU_MAX);
+    mg_actor_init(&g_coordinator, coordinator_fn, 0, 0);
+    assert(g_req_count == MG_CPU_MAX);
+    assert(g_worker_queue[0].length == (ITEMS / MG_CPU_MAX) - 1);
+
+    g_cpu = 1;
+    mg_context_schedule(0);
+    assert(handled[1] == ITEMS / MG_CPU_MAX);
+    assert(!joined);
+
+    g_cpu = 0;
+    mg_context_schedule(0);
+    assert(handled[0] == ITEMS / MG_CPU_MAX);
+    assert(joined);
+    assert(g_item_pool.queue.length == ITEMS);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <assert.h>
+#include <stdbool.h>
+#include "magnesium.h"
+#include "mg_shared.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { RECEIVERS = 3 };
+
+static struct frame_t {
+    struct mg_shared_t header;
+    unsigned int payload;
+} g_frames[1];
+
+static struct mg_envelope_t g_envelopes[RECEIVERS];
+static struct mg_message_pool_t g_frame_pool;
+static struct mg_message_pool_t g_envelope_pool;
+static struct mg_queue_t g_queues[RECEIVERS];
+static struct mg_actor_t g_actors[RECEIVERS];
+struct mg_context_t g_mg_context;
+static unsigned received = 0;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    const unsigned i = (unsigned)(self - g_actors);
+    struct frame_t* const frame = (struct frame_t*) mg_shared_payload(m);
+    assert(frame == &g_frames[0]);
+    assert(frame->payload == 0xc0cac01a);
+    received++;
+    mg_message_free(m);
+    assert((g_frame_pool.queue.length == 1) == (received == RECEIVERS));
+    return &g_queues[i];
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_frame_pool, &g_frames, sizeof(g_frames), sizeof(g_frames[0]));
+    mg_envelope_pool_init(&g_envelope_pool, &g_envelopes, sizeof(g_envelopes));
+    struct mg_queue_t* queues[RECEIVERS];
+
+    for (unsigned i = 0; i < RECEIVERS; ++i) {
+        mg_queue_init(&g_queues[i]);
+        mg_actor_init(&g_actors[i], actor_fn, 0, &g_queues[i]);
+        queues[i] = &g_queues[i];
+    }
+
+    struct frame_t* const frame = mg_message_alloc(&g_frame_pool);
+    assert(frame);
+    frame->payload = 0xc0cac01a;
+    assert(!mg_shared_push(&g_envelope_pool, &frame->header, queues, RECEIVERS + 1));
+    assert(g_envelope_pool.queue.length == RECEIVERS);
+    assert(!g_req);
+
+    assert(mg_shared_push(&g_envelope_pool, &frame->header, queues, RECEIVERS));
+    assert(g_req);
+    mg_context_schedule(0);
+    assert(received == RECEIVERS);
+    assert(g_frame_pool.queue.length == 1);
+    assert(g_envelope_pool.queue.length == RECEIVERS);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#define MG_MESSAGE_PRIO
+#include "magnesium.h"
+#include "mg_slot.h"
+#include "mocks.h"
+#include <stdio.h>
+
+static struct sample_t {
+    struct mg_message_t header;
+    unsigned int value;
+} g_samples[3];
+
+static struct mg_message_pool_t g_pool;
+static struct mg_slot_t g_slot;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+static unsigned actor_calls = 0;
+static unsigned last_value = 0;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    struct sample_t* const sample = (struct sample_t*) mg_slot_take(&g_slot, m);
+    assert(sample);
+    actor_calls++;
+    last_value = sample->value;
+    mg_message_free(&sample->header);
+    return &g_slot.queue;
+}
+
+static void publish(unsigned value) {
+    struct sample_t* const sample = mg_message_alloc(&g_pool);
+    assert(sample);
+    sample->value = value;
+    mg_slot_publish(&g_slot, &sample->header);
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_samples, sizeof(g_samples), sizeof(g_samples[0]));
+    memset(&g_slot, 0xff, sizeof(g_slot));
+    mg_slot_init(&g_slot);
+    assert(g_slot.token.prio == 0);
+    mg_actor_init(&g_actor, actor_fn, 0, &g_slot.queue);
+
+    publish(1);
+    assert(g_req);
+    g_req = false;
+
+    for (unsigned i = 2; i <= 100; ++i) {
+        publish(i);
+        assert(!g_req);
+    }
+
+    mg_context_schedule(0);
+    assert((actor_calls == 1) && (last_value == 100));
+    assert(g_pool.queue.length == 3);
+
+    publish(101);
+    assert(g_req);
+    mg_context_schedule(0);
+    assert((actor_calls == 2) && (last_value == 101));
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#define MG_CPU_MAX 2
+#include <assert.h>
+#include <stdbool.h>
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+static struct mg_message_t g_msgs[2];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue1;
+static struct mg_queue_t g_queue2;
+static struct mg_actor_t g_actor1;
+static struct mg_actor_t g_actor2;
+struct mg_context_t g_mg_context;
+
+static unsigned g_cpu = 0;
+static unsigned actor2_cpu = MG_CPU_MAX;
+
+unsigned int mg_cpu_this(void) {
+    return g_cpu;
+}
+
+struct mg_queue_t* actor1_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    mg_queue_push(&g_queue2, m);
+    assert(g_req_cpu == 1);
+    assert(g_mg_context.migratable[0] == 1);
+    g_cpu = 1;
+    mg_context_schedule(0);
+    g_cpu = 0;
+    assert(actor2_cpu == 1);
+    return &g_queue1;
+}
+
+struct mg_queue_t* actor2_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    actor2_cpu = mg_cpu_this();
+    assert(self->cpu == actor2_cpu);
+    mg_message_free(m);
+    return &g_queue2;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue1);
+    mg_queue_init(&g_queue2);
+    mg_actor_init(&g_actor1, actor1_fn, 0, &g_queue1);
+    mg_actor_init(&g_actor2, actor2_fn, 0, &g_queue2);
+    g_actor2.flags = MG_ACTOR_MIGRATABLE;
+    
+    mg_queue_push(&g_queue1, mg_message_alloc(&g_pool));
+    assert(g_req && (g_req_cpu == 0));
+    mg_context_schedule(0);
+    assert(g_actor2.cpu == 1);
+    assert(g_mg_context.migratable[0] == 0);
+
+    actor2_cpu = MG_CPU_MAX;
+    mg_queue_push(&g_queue2, mg_message_alloc(&g_pool));
+    assert(g_req_cpu == 1);
+    g_cpu = 1;
+    mg_context_schedule(0);
+    assert(actor2_cpu == 1);
+    assert(g_mg_context.migratable[0] == 0);
+
+    /* Shared runqueues are empty, nothing to steal. */
+    g_cpu = 0;
+    assert(_mg_context_steal(0) == 0);
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <stdbool.h>
+#include "magnesium.h"
+#include "mg_topic.h"
+#include "mocks.h"
+#include <stdio.h>
+
+enum { SUBSCRIBERS = 2 };
+
+static struct state_t {
+    struct mg_shared_t header;
+    unsigned int value;
+} g_states[2];
+
+static struct mg_envelope_t g_envelopes[SUBSCRIBERS];
+static struct mg_message_pool_t g_state_pool;
+static struct mg_message_pool_t g_envelope_pool;
+static struct mg_queue_t g_queues[SUBSCRIBERS];
+static struct mg_actor_t g_actors[SUBSCRIBERS];
+static struct mg_queue_t g_urgent_queue;
+static struct mg_actor_t g_urgent;
+static struct mg_topic_t g_topic;
+struct mg_context_t g_mg_context;
+static unsigned received[SUBSCRIBERS] = { 0 };
+static unsigned unsubscribed = 0;
+static bool quiescent = false;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    const unsigned i = (unsigned)(self - g_actors);
+    const struct state_t* const state = (struct state_t*) mg_shared_payload(m);
+    received[i] = state->value;
+    mg_message_free(m);
+    return &g_queues[i];
+}
+
+/*
+ * Runs at priority 1, so it preempts the publisher in the middle of delivery.
+ */
+struct mg_queue_t* urgent_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    unsubscribed = mg_topic_unsubscribe(&g_topic, &g_queues[1]);
+    quiescent = mg_topic_quiescent(&g_topic, unsubscribed);
+    mg_message_free(m);
+    return &g_urgent_queue;
+}
+
+static void publish(unsigned value) {
+    struct state_t* const state = mg_message_alloc(&g_state_pool);
+    assert(state);
+    state->value = value;
+    assert(mg_topic_publish(&g_topic, &state->header));
+    mg_context_schedule(0);
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_state_pool, &g_states, sizeof(g_states), sizeof(g_states[0]));
+    mg_envelope_pool_init(&g_envelope_pool, &g_envelopes, sizeof(g_envelopes));
+    mg_topic_init(&g_topic, &g_envelope_pool);
+
+    for (unsigned i = 0; i < SUBSCRIBERS; ++i) {
+        mg_queue_init(&g_queues[i]);
+        mg_actor_init(&g_actors[i], actor_fn, 0, &g_queues[i]);
+        assert(mg_topic_subscribe(&g_topic, &g_queues[i]));
+    }
+
+    publish(1);
+    assert((received[0] == 1) && (received[1] == 1));
+    mg_topic_unsubscribe(&g_topic, &g_queues[0]);
+    publish(2);
+    assert((received[0] == 1) && (received[1] == 2));
+    mg_topic_unsubscribe(&g_topic, &g_queues[1]);
+    publish(3);
+    assert((received[0] == 1) && (received[1] == 2));
+    assert(g_state_pool.queue.length == 2);
+    assert(g_envelope_pool.queue.length == SUBSCRIBERS);
+
+    mg_queue_init(&g_urgent_queue);
+    mg_actor_init(&g_urgent, urgent_fn, 1, &g_urgent_queue);
+    assert(mg_topic_subscribe(&g_topic, &g_urgent_queue));
+    assert(mg_topic_subscribe(&g_topic, &g_queues[1]));
+    publish(4);
+    assert(!quiescent);
+    assert(received[1] == 4);
+
+    /* Publisher on another CPU started after the unsubscription. */
+    const unsigned late = g_topic.epoch & 1;
+    g_topic.publishing[late]++;
+    assert(mg_topic_quiescent(&g_topic, unsubscribed));
+    g_topic.publishing[late]--;
+    publish(5);
+    assert(received[1] == 4);
+    assert(mg_topic_quiescent(&g_topic, mg_topic_unsubscribe(&g_topic, &g_urgent_queue)));
+    assert(g_state_pool.queue.length == 2);
+    assert(g_envelope_pool.queue.length == SUBSCRIBERS);
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <assert.h>
+#include <stdbool.h>
+
+enum { EV_ACTIVATE, EV_START, EV_STOP, EV_PUSH, EV_POP, EV_SUBSCRIBE, EV_ALLOC, 
+    EV_FREE, EV_EMPTY, EV_ARM, EV_EXPIRE, EV_LOCK, EV_UNLOCK, EV_MAX };
+
+static unsigned g_events[EV_MAX];
+
+#define MG_TRACE_ACTOR_ACTIVATE(actor, cpu, vect) ++g_events[EV_ACTIVATE]
+#define MG_TRACE_ACTOR_START(actor, msg) ++g_events[EV_START]
+#define MG_TRACE_ACTOR_STOP(actor, q) ++g_events[EV_STOP]
+#define MG_TRACE_QUEUE_PUSH(q, msg) ++g_events[EV_PUSH]
+#define MG_TRACE_QUEUE_POP(q, msg) ++g_events[EV_POP]
+#define MG_TRACE_QUEUE_SUBSCRIBE(q, actor) ++g_events[EV_SUBSCRIBE]
+#define MG_TRACE_POOL_ALLOC(pool, msg) ++g_events[EV_ALLOC]
+#define MG_TRACE_POOL_FREE(pool, msg) ++g_events[EV_FREE]
+#define MG_TRACE_POOL_EMPTY(pool) ++g_events[EV_EMPTY]
+#define MG_TRACE_TIMER_ARM(actor, ticks) ++g_events[EV_ARM]
+#define MG_TRACE_TIMER_EXPIRE(actor) ++g_events[EV_EXPIRE]
+#define MG_TRACE_LOCK_ACQUIRE(lock) ++g_events[EV_LOCK]
+#define MG_TRACE_LOCK_RELEASE(lock) ++g_events[EV_UNLOCK]
+
+#include "magnesium.h"
+#include "mocks.h"
+#include <stdio.h>
+
+static struct mg_message_t g_msgs[1];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    MG_ACTOR_START;
+
+    for (;;) {
+        MG_AWAIT(&g_queue);
+        mg_message_free(m);
+        MG_AWAIT(mg_sleep_for(2, self));
+    }
+
+    MG_ACTOR_END;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    mg_actor_init(&g_actor, actor_fn, 0, 0);
+    assert((g_events[EV_START] == 1) && (g_events[EV_STOP] == 1));
+    assert(g_events[EV_SUBSCRIBE] == 1);
+
+    struct mg_message_t* const msg = mg_message_alloc(&g_pool);
+    assert(msg != 0);
+    assert(mg_message_alloc(&g_pool) == 0);
+    assert((g_events[EV_ALLOC] == 1) && (g_events[EV_EMPTY] == 1));
+
+    mg_queue_push(&g_queue, msg);
+    assert((g_events[EV_PUSH] == 1) && (g_events[EV_ACTIVATE] == 1));
+    mg_context_schedule(0);
+    assert((g_events[EV_START] == 2) && (g_events[EV_STOP] == 2));
+    assert((g_events[EV_FREE] == 1) && (g_events[EV_ARM] == 1));
+
+    mg_context_tick();
+    mg_context_tick();
+    assert((g_events[EV_EXPIRE] == 1) && (g_events[EV_ACTIVATE] == 2));
+    mg_context_schedule(0);
+    assert(g_events[EV_SUBSCRIBE] == 2);
+    assert(g_events[EV_POP] == 0);
+    assert(g_events[EV_LOCK] == g_events[EV_UNLOCK]);
+    assert(g_events[EV_LOCK] != 0);
+
+    return 0;
+}
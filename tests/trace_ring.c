@@ -0,0 +1,63 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+static uint32_t g_cycles = 0;
+#define mg_port_cycles() (g_cycles += 10)
+#define MG_TRACE_RING_LOG2 3
+
+#include "mg_trace.h"
+#include "mocks.h"
+#include <stdio.h>
+
+static struct mg_message_t g_msgs[1];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+struct mg_trace_t g_mg_trace;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+    mg_message_free(m);
+    return &g_queue;
+}
+
+static const struct mg_trace_event_t* event(uint32_t i) {
+    return &g_mg_trace.rings[0].events[i & (MG_TRACE_RING_SIZE - 1)];
+}
+
+int main(void) {
+    mg_trace_init();
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    mg_actor_init(&g_actor, actor_fn, 0, &g_queue);
+    assert(g_mg_trace.rings[0].head == 1);
+    assert(event(0)->type == MG_TRACE_EV_SUBSCRIBE);
+    assert(event(0)->object == (uint32_t)(uintptr_t) &g_queue);
+    assert(event(0)->arg == (uint32_t)(uintptr_t) &g_actor);
+
+    struct mg_message_t* const msg = mg_message_alloc(&g_pool);
+    mg_queue_push(&g_queue, msg);
+    mg_context_schedule(0);
+
+    static const unsigned expected[] = {
+        MG_TRACE_EV_SUBSCRIBE, MG_TRACE_EV_ALLOC, MG_TRACE_EV_PUSH, 
+        MG_TRACE_EV_ACTIVATE, MG_TRACE_EV_START, MG_TRACE_EV_FREE, 
+        MG_TRACE_EV_PUSH, MG_TRACE_EV_STOP, MG_TRACE_EV_SUBSCRIBE
+    };
+    const uint32_t head = g_mg_trace.rings[0].head;
+    assert(head == sizeof(expected) / sizeof(expected[0]));
+
+    for (uint32_t i = head - MG_TRACE_RING_SIZE; i != head; ++i) {
+        assert(event(i)->type == expected[i]);
+        assert(event(i)->cycles == (i + 1) * 10);
+    }
+
+    assert(event(3)->arg == 0);
+    assert(event(4)->arg == (uint32_t)(uintptr_t) msg);
+    assert(event(7)->arg == (uint32_t)(uintptr_t) &g_queue);
+
+    return 0;
+}
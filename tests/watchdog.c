@@ -0,0 +1,72 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct mg_actor_t;
+static struct mg_actor_t* g_alarm_actor = 0;
+static bool g_alarm_running = false;
+static unsigned g_alarms = 0;
+
+#define MG_WATCHDOG_TICKS 3
+#define MG_WATCHDOG_ALARM(actor, cpu, running) \
+    do { g_alarm_actor = (actor); g_alarm_running = (running); ++g_alarms; } while (0)
+
+#include "magnesium.h"
+#include "mocks.h"
+
+static struct mg_message_t g_msgs[2];
+static struct mg_message_pool_t g_pool;
+static struct mg_queue_t g_queue;
+static struct mg_actor_t g_actor;
+struct mg_context_t g_mg_context;
+static unsigned g_busy_ticks = 0;
+
+struct mg_queue_t* actor_fn(struct mg_actor_t *self, struct mg_message_t* restrict m) {
+    UNUSED_ARG(self);
+
+    for (unsigned i = 0; i < g_busy_ticks; ++i) {
+        mg_context_tick();
+    }
+
+    mg_message_free(m);
+    return &g_queue;
+}
+
+int main(void) {
+    mg_context_init();
+    mg_message_pool_init(&g_pool, &g_msgs, sizeof(g_msgs), sizeof(g_msgs[0]));
+    mg_queue_init(&g_queue);
+    mg_actor_init(&g_actor, actor_fn, 0, &g_queue);
+    const struct mg_watchdog_t* const wd = &MG_CPU_CONTEXT(0)->watchdog[0];
+
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    assert((wd->depth == 1) && (wd->max_depth == 1));
+    mg_context_tick();
+    mg_context_tick();
+    assert(g_alarms == 0);
+    mg_context_tick();
+    assert((g_alarms == 1) && (g_alarm_actor == &g_actor) && !g_alarm_running);
+    mg_context_tick();
+    assert((g_alarms == 1) && (wd->starvations == 1));
+
+    mg_context_schedule(0);
+    assert((wd->depth == 0) && (wd->running == 0));
+
+    g_busy_ticks = 5;
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    mg_context_schedule(0);
+    assert((g_alarms == 2) && (g_alarm_actor == &g_actor) && g_alarm_running);
+    assert((wd->stalls == 1) && (wd->running == 0));
+
+    g_busy_ticks = 2;
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    mg_context_schedule(0);
+    assert(g_alarms == 2);
+
+    /* Backlog longer than the limit in total is not a stall. */
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    mg_queue_push(&g_queue, mg_message_alloc(&g_pool));
+    mg_context_schedule(0);
+    assert((g_alarms == 2) && (wd->stalls == 1));
+    return 0;
+}
@@ -0,0 +1,210 @@
+/**
+  * @file  mgtop.c
+  * @brief Host-side viewer of snapshots produced by mg_snapshot.h.
+  * License: BSD-2-Clause.
+  *
+  * Build: cc -O2 -o mgtop mgtop.c
+  * Usage: mgtop [-1] [-d <seconds>] <shared memory file or dump>
+  *
+  * Snapshots published with mg_snapshot_shm("/mgtop") are seen as
+  * /dev/shm/mgtop on Linux. With -1 the snapshot is printed once, which is
+  * useful for memory dumps taken from target.
+  */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define MG_SNAPSHOT_MAGIC 0x4E53474DU
+#define HEADER_SIZE 24
+#define ACTOR_SIZE 36
+#define QUEUE_SIZE 28
+#define POOL_SIZE 28
+#define NAME_SIZE 16
+#define MAX_ACTORS 1024
+
+static const char* const g_states[] = { "runnable", "waiting", "sleeping" };
+
+struct prev_t {
+    uint32_t object;
+    uint32_t cycles;
+};
+
+static uint32_t rd32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static unsigned rd16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+/*
+ * The file is re-read until the sequence number is even and the same before
+ * and after the copy, i.e. the writer was not active during the read.
+ */
+static size_t load(const char* path, unsigned char* buf, size_t len) {
+    for (unsigned attempt = 0; attempt < 100; ++attempt) {
+        FILE* const f = fopen(path, "rb");
+
+        if (!f) {
+            return 0;
+        }
+
+        const size_t size = fread(buf, 1, len, f);
+        uint32_t seq = 0;
+        const bool reread = (fseek(f, 4, SEEK_SET) == 0) &&
+            (fread(&seq, sizeof(seq), 1, f) == 1);
+        fclose(f);
+
+        if ((size < HEADER_SIZE) || !reread) {
+            return size;
+        }
+
+        const uint32_t before = rd32(buf + 4);
+        const unsigned char* const p = (const unsigned char*) &seq;
+
+        if (((before & 1) == 0) && (before == rd32(p))) {
+            return size;
+        }
+    }
+
+    return 0;
+}
+
+static void name(char* dst, const unsigned char* src) {
+    memcpy(dst, src, NAME_SIZE);
+    dst[NAME_SIZE - 1] = '\0';
+}
+
+static bool print(const unsigned char* data, size_t size, struct prev_t* prev) {
+    if ((size < HEADER_SIZE) || (rd32(data) != MG_SNAPSHOT_MAGIC)) {
+        return false;
+    }
+
+    const unsigned actor_count = rd16(data + 12);
+    const unsigned actor_max = rd16(data + 14);
+    const unsigned queue_count = rd16(data + 16);
+    const unsigned queue_max = rd16(data + 18);
+    const unsigned pool_count = rd16(data + 20);
+    const unsigned pool_max = rd16(data + 22);
+    const size_t queues = HEADER_SIZE + (size_t) actor_max * ACTOR_SIZE;
+    const size_t pools = queues + (size_t) queue_max * QUEUE_SIZE;
+
+    if ((actor_count > actor_max) || (queue_count > queue_max) ||
+        (pool_count > pool_max) || (size < pools + (size_t) pool_max * POOL_SIZE)) {
+        return false;
+    }
+
+    char str[NAME_SIZE];
+    uint64_t total = 0;
+
+    for (unsigned i = 0; (i < actor_count) && (i < MAX_ACTORS); ++i) {
+        const unsigned char* const p = data + HEADER_SIZE + i * ACTOR_SIZE;
+        total += (prev[i].object == rd32(p + 16)) ? (uint32_t)(rd32(p + 28) - prev[i].cycles) : 0;
+    }
+
+    printf("cpu0 ticks %lu\n\n%-16s %10s %4s %4s %-9s %10s %10s %6s\n",
+        (unsigned long) rd32(data + 8),
+        "ACTOR", "OBJECT", "CPU", "VECT", "STATE", "QUEUE", "ACT", "CPU%");
+
+    for (unsigned i = 0; i < actor_count; ++i) {
+        const unsigned char* const p = data + HEADER_SIZE + i * ACTOR_SIZE;
+        const uint32_t object = rd32(p + 16);
+        const uint32_t cycles = rd32(p + 28);
+        const unsigned state = p[34];
+        unsigned permille = 0;
+
+        if (i < MAX_ACTORS) {
+            if (total && (prev[i].object == object)) {
+                permille = (unsigned)(((uint64_t)(uint32_t)(cycles - prev[i].cycles) * 1000) / total);
+            }
+
+            prev[i].object = object;
+            prev[i].cycles = cycles;
+        }
+
+        name(str, p);
+        printf("%-16s 0x%08lx %4u %4u %-9s ", str, (unsigned long) object, p[35],
+            rd16(p + 32), (state < 3) ? g_states[state] : "?");
+
+        if (rd32(p + 20)) {
+            printf("0x%08lx", (unsigned long) rd32(p + 20));
+        } else {
+            printf("%10s", "-");
+        }
+
+        printf(" %10lu %4u.%u\n", (unsigned long) rd32(p + 24), permille / 10, permille % 10);
+    }
+
+    printf("\n%-16s %10s %8s %8s\n", "QUEUE", "OBJECT", "LENGTH", "CAPACITY");
+
+    for (unsigned i = 0; i < queue_count; ++i) {
+        const unsigned char* const p = data + queues + i * QUEUE_SIZE;
+        name(str, p);
+        printf("%-16s 0x%08lx %8ld %8ld\n", str, (unsigned long) rd32(p + 16),
+            (long)(int32_t) rd32(p + 20), (long)(int32_t) rd32(p + 24));
+    }
+
+    printf("\n%-16s %10s %8s %8s\n", "POOL", "OBJECT", "BLOCKS", "FREE");
+
+    for (unsigned i = 0; i < pool_count; ++i) {
+        const unsigned char* const p = data + pools + i * POOL_SIZE;
+        name(str, p);
+        printf("%-16s 0x%08lx %8lu %8lu\n", str, (unsigned long) rd32(p + 16),
+            (unsigned long) rd32(p + 20), (unsigned long) rd32(p + 24));
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool once = false;
+    double delay = 1.0;
+    int i = 1;
+
+    for (; (i < argc - 1) && (argv[i][0] == '-'); ++i) {
+        if (strcmp(argv[i], "-1") == 0) {
+            once = true;
+        } else if ((strcmp(argv[i], "-d") == 0) && (i < argc - 2)) {
+            delay = atof(argv[++i]);
+        } else {
+            break;
+        }
+    }
+
+    if ((i != argc - 1) || !(delay > 0)) {
+        fprintf(stderr, "usage: %s [-1] [-d <seconds>] <snapshot>\n", argv[0]);
+        return 1;
+    }
+
+    static unsigned char data[1 << 20];
+    static struct prev_t prev[MAX_ACTORS];
+    const struct timespec pause = {
+        (time_t) delay, (long)((delay - (double)(time_t) delay) * 1e9)
+    };
+
+    for (;;) {
+        const size_t size = load(argv[i], data, sizeof(data));
+
+        if (!once) {
+            printf("\033[H\033[2J");
+        }
+
+        if (!print(data, size, prev)) {
+            fprintf(stderr, "%s is not a snapshot\n", argv[i]);
+            return 1;
+        }
+
+        if (once) {
+            return 0;
+        }
+
+        fflush(stdout);
+        nanosleep(&pause, 0);
+    }
+}
@@ -0,0 +1,364 @@
+/**
+  * @file  mgtrace.c
+  * @brief Host-side decoder of trace ring dumps produced by mg_trace.h.
+  * License: BSD-2-Clause.
+  *
+  * Build: cc -O2 -o mgtrace mgtrace.c
+  * Usage: mgtrace [-c] [-f <MHz>] <dump of g_mg_trace>
+  *
+  * With -c the output is Chrome trace-event JSON which may be opened in
+  * chrome://tracing or ui.perfetto.dev.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define MG_TRACE_MAGIC 0x5254474DU
+#define HEADER_SIZE 8
+#define RING_HEADER_SIZE 8
+#define EVENT_SIZE 16
+
+struct event_t {
+    uint64_t time;
+    unsigned cpu;
+    unsigned type;
+    unsigned vect;
+    unsigned aux;
+    uint32_t object;
+    uint32_t arg;
+};
+
+static const char* const g_names[] = {
+    "?", "activate", "start", "stop", "push", "pop", "subscribe",
+    "alloc", "free", "empty", "arm", "expire", "lock", "unlock"
+};
+
+static uint32_t rd32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static unsigned rd16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned char* load(const char* path, size_t* size) {
+    FILE* const f = fopen(path, "rb");
+
+    if (!f) {
+        return 0;
+    }
+
+    fseek(f, 0, SEEK_END);
+    const long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* const data = (len > 0) ? malloc((size_t) len) : 0;
+
+    if (!data) {
+        fclose(f);
+        return 0;
+    }
+
+    if (fread(data, 1, (size_t) len, f) != (size_t) len) {
+        free(data);
+        fclose(f);
+        return 0;
+    }
+
+    fclose(f);
+    *size = (size_t) len;
+    return data;
+}
+
+static int by_time(const void* a, const void* b) {
+    const struct event_t* const x = a;
+    const struct event_t* const y = b;
+
+    if (x->time != y->time) {
+        return (x->time < y->time) ? -1 : 1;
+    }
+
+    return (x->cpu < y->cpu) ? -1 : (x->cpu > y->cpu);
+}
+
+/*
+ * Events of each CPU are taken in ring order starting from the oldest one,
+ * 32-bit cycle counter is extended to 64 bits by accumulating differences
+ * between neighbours. The difference is signed since a nested interrupt may
+ * store an earlier timestamp into a later slot, so the time base starts at
+ * 2^32 to stay positive. Then all CPUs are merged by time.
+ */
+static struct event_t* decode(const unsigned char* data, size_t size, size_t* count) {
+    if ((size < HEADER_SIZE) || (rd32(data) != MG_TRACE_MAGIC)) {
+        return 0;
+    }
+
+    const unsigned cpus = rd16(data + 4);
+    const unsigned ring_size = rd16(data + 6);
+    const size_t ring_bytes = RING_HEADER_SIZE + (size_t) ring_size * EVENT_SIZE;
+
+    if ((ring_size == 0) || (size < HEADER_SIZE + cpus * ring_bytes)) {
+        return 0;
+    }
+
+    struct event_t* const events = malloc(sizeof(struct event_t) * cpus * ring_size + 1);
+    size_t n = 0;
+
+    if (!events) {
+        return 0;
+    }
+
+    for (unsigned cpu = 0; cpu < cpus; ++cpu) {
+        const unsigned char* const ring = data + HEADER_SIZE + cpu * ring_bytes;
+        const uint32_t head = rd32(ring);
+        const uint32_t used = (head < ring_size) ? head : ring_size;
+        uint64_t time = 0;
+        uint32_t prev = 0;
+
+        for (uint32_t i = head - used; i != head; ++i) {
+            const unsigned char* const p =
+                ring + RING_HEADER_SIZE + (i % ring_size) * EVENT_SIZE;
+            const uint32_t cycles = rd32(p);
+            time = (i == head - used) ?
+                (cycles + ((uint64_t) 1 << 32)) : time + (int64_t)(int32_t)(cycles - prev);
+            prev = cycles;
+            struct event_t* const e = &events[n++];
+            e->time = time;
+            e->cpu = cpu;
+            e->type = p[4];
+            e->vect = p[5];
+            e->aux = rd16(p + 6);
+            e->object = rd32(p + 8);
+            e->arg = rd32(p + 12);
+        }
+    }
+
+    qsort(events, n, sizeof(struct event_t), by_time);
+    *count = n;
+    return events;
+}
+
+static const char* name(unsigned type) {
+    return (type < sizeof(g_names) / sizeof(g_names[0])) ? g_names[type] : "?";
+}
+
+/*
+ * Each CPU is a process and each vector is a thread, so nested preemption is
+ * shown as overlapping slices on separate tracks. A push is linked by flow
+ * arrow to the start of the actor which receives the same message. Pushes
+ * outside of actors (e.g. from device interrupts) are put on separate track.
+ * Frees are pushes to pool queues which are never received by actors, so
+ * pools seen in alloc/free/empty events get no flows.
+ */
+#define MAX_CPUS 64
+#define MAX_NESTING 32
+#define MAX_FLOWS 1024
+#define MAX_POOLS 256
+#define ISR_TRACK 256
+
+struct flow_t {
+    uint32_t msg;
+    unsigned id;
+};
+
+static bool is_pool(const uint32_t* pools, unsigned count, uint32_t object) {
+    for (unsigned i = 0; i < count; ++i) {
+        if (pools[i] == object) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void print_chrome(const struct event_t* events, size_t count, double mhz) {
+    static unsigned stack[MAX_CPUS][MAX_NESTING];
+    static unsigned depth[MAX_CPUS];
+    static bool used[MAX_CPUS][ISR_TRACK + 1];
+    static struct flow_t flows[MAX_FLOWS];
+    static uint32_t pools[MAX_POOLS];
+    unsigned pool_count = 0;
+    unsigned flow_count = 0;
+    unsigned next_id = 1;
+    const char* sep = "";
+
+    for (size_t i = 0; i < count; ++i) {
+        const struct event_t* const e = &events[i];
+
+        if ((e->type >= 7) && (e->type <= 9) && (pool_count < MAX_POOLS) &&
+            !is_pool(pools, pool_count, e->object)) {
+            pools[pool_count++] = e->object;
+        }
+    }
+
+    printf("{\"traceEvents\":[\n");
+
+    for (size_t i = 0; i < count; ++i) {
+        const struct event_t* const e = &events[i];
+        const double ts = (double)(e->time - events[0].time) / mhz;
+        const unsigned cpu = e->cpu % MAX_CPUS;
+        const unsigned track = depth[cpu] ? stack[cpu][depth[cpu] - 1] : ISR_TRACK;
+
+        switch (e->type) {
+        case 2: /* start */
+            if (depth[cpu] < MAX_NESTING) {
+                stack[cpu][depth[cpu]++] = e->vect;
+            }
+
+            used[cpu][e->vect] = true;
+            printf("%s{\"ph\":\"B\",\"name\":\"actor 0x%08lx\",\"pid\":%u,\"tid\":%u,"
+                "\"ts\":%.3f,\"args\":{\"msg\":\"0x%08lx\"}}",
+                sep, (unsigned long) e->object, cpu, e->vect, ts, (unsigned long) e->arg);
+            sep = ",\n";
+
+            for (unsigned j = 0; (e->arg != 0) && (j < flow_count); ++j) {
+                if (flows[j].msg == e->arg) {
+                    printf("%s{\"ph\":\"f\",\"bp\":\"e\",\"name\":\"msg\",\"cat\":\"msg\","
+                        "\"id\":%u,\"pid\":%u,\"tid\":%u,\"ts\":%.3f}",
+                        sep, flows[j].id, cpu, e->vect, ts);
+                    flows[j] = flows[--flow_count];
+                    break;
+                }
+            }
+            break;
+        case 3: /* stop */
+            if (depth[cpu]) {
+                --depth[cpu];
+            }
+
+            printf("%s{\"ph\":\"E\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f}",
+                sep, cpu, e->vect, ts);
+            sep = ",\n";
+            break;
+        case 4: /* push */
+            if (is_pool(pools, pool_count, e->object)) {
+                break;
+            }
+
+            unsigned j = 0;
+
+            while ((j < flow_count) && (flows[j].msg != e->arg)) {
+                ++j;
+            }
+
+            if (j == MAX_FLOWS) {
+                break; /* Flow end could not be matched. */
+            }
+
+            flows[j].msg = e->arg;
+            flows[j].id = next_id;
+            flow_count += (j == flow_count);
+            used[cpu][track] = true;
+            printf("%s{\"ph\":\"s\",\"name\":\"msg\",\"cat\":\"msg\",\"id\":%u,"
+                "\"pid\":%u,\"tid\":%u,\"ts\":%.3f}", sep, next_id++, cpu, track, ts);
+            sep = ",\n";
+            break;
+        case 1: /* activate */
+        case 9: /* empty */
+        case 11: /* expire */
+            used[cpu][track] = true;
+            printf("%s{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s 0x%08lx\",\"pid\":%u,"
+                "\"tid\":%u,\"ts\":%.3f}",
+                sep, name(e->type), (unsigned long) e->object, cpu, track, ts);
+            sep = ",\n";
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (unsigned cpu = 0; cpu < MAX_CPUS; ++cpu) {
+        bool named = false;
+
+        for (unsigned track = 0; track <= ISR_TRACK; ++track) {
+            if (used[cpu][track]) {
+                if (!named) {
+                    printf("%s{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,"
+                        "\"args\":{\"name\":\"cpu %u\"}}", sep, cpu, cpu);
+                    sep = ",\n";
+                    named = true;
+                }
+
+                printf("%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,",
+                    sep, cpu, track);
+
+                if (track == ISR_TRACK) {
+                    printf("\"args\":{\"name\":\"other\"}}");
+                } else {
+                    printf("\"args\":{\"name\":\"vect %u\"}}", track);
+                }
+
+                sep = ",\n";
+            }
+        }
+    }
+
+    printf("\n]}\n");
+}
+
+static void print_text(const struct event_t* events, size_t count) {
+    printf("%12s %3s %-10s %4s %10s %10s\n", "cycles", "cpu", "event", "vect", "object", "arg");
+
+    for (size_t i = 0; i < count; ++i) {
+        const struct event_t* const e = &events[i];
+        printf("%12llu %3u %-10s %4u 0x%08lx 0x%08lx",
+            (unsigned long long)(e->time - events[0].time), e->cpu, name(e->type),
+            e->vect, (unsigned long) e->object, (unsigned long) e->arg);
+
+        if (e->type == 1) {
+            printf(" -> cpu %u", e->aux);
+        }
+
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    bool chrome = false;
+    double mhz = 1.0;
+    int i = 1;
+
+    for (; (i < argc - 1) && (argv[i][0] == '-'); ++i) {
+        if (strcmp(argv[i], "-c") == 0) {
+            chrome = true;
+        } else if ((strcmp(argv[i], "-f") == 0) && (i < argc - 2)) {
+            mhz = atof(argv[++i]);
+        } else {
+            break;
+        }
+    }
+
+    if ((i != argc - 1) || !(mhz > 0)) {
+        fprintf(stderr, "usage: %s [-c] [-f <MHz>] <dump>\n", argv[0]);
+        return 1;
+    }
+
+    size_t size = 0;
+    unsigned char* const data = load(argv[i], &size);
+
+    if (!data) {
+        fprintf(stderr, "can't read %s\n", argv[i]);
+        return 1;
+    }
+
+    size_t count = 0;
+    struct event_t* const events = decode(data, size, &count);
+
+    if (!events) {
+        fprintf(stderr, "%s is not a trace dump\n", argv[i]);
+        free(data);
+        return 1;
+    }
+
+    if (chrome) {
+        print_chrome(events, count, mhz);
+    } else {
+        print_text(events, count);
+    }
+
+    free(events);
+    free(data);
+    return 0;
+}